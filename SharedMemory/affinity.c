@@ -0,0 +1,170 @@
+// sched_setaffinity and pthread_attr_setaffinity_np need gnu extensions
+#define _GNU_SOURCE
+
+// include system headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <sched.h>
+#include <pthread.h>
+
+// include own header
+#include "affinity.h"
+
+extern const char * __progname; // gcc defined as substitute for argv[0]
+
+extern int verbose_flag; // verbose flag
+
+#define MAX_SYSFS_LIST_LENGTH 4096 // longest cpu list read from sysfs
+#define MAX_CACHE_INDEXES 8 // cache levels looked at for each cpu
+
+// a cpu and where it sits, for ordering
+struct Placement {
+    int cpu;
+    int group; // lowest cpu sharing the chosen cache, cpu itself if none is shared
+    int rank; // position among hardware threads of its core, 0 for first one
+};
+
+// private function list
+void Sched_setaffinity(const cpu_set_t * set);
+int read_sysfs_cpu_list(const char * path, int * cpus, int max);
+int compare_placement(const void * a, const void * b);
+
+// sched_setaffinity wrapper
+void Sched_setaffinity(const cpu_set_t * set) {
+    if (sched_setaffinity(0, sizeof(cpu_set_t), set) == -1) {
+        printf("sched_setaffinity failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to set cpu affinity.\n", __progname);
+        exit(-1);
+    }
+}
+
+int parse_cpu_list(const char * list, int * cpus, int max) {
+    int count = 0;
+    const char * position = list;
+    while (*position && *position != '\n') {
+        char * end;
+        if (!isdigit((unsigned char)*position)) return -1;
+        long first = strtol(position, &end, 10), last = first;
+        if (*end == '-') {
+            position = end + 1;
+            if (!isdigit((unsigned char)*position)) return -1;
+            last = strtol(position, &end, 10);
+        }
+        if (last < first || last >= CPU_SETSIZE) return -1;
+        for (long cpu = first ; cpu <= last ; ++cpu) {
+            if (count == max) return -1;
+            cpus[count++] = cpu;
+        }
+        position = end;
+        if (*position == ',') ++position;
+        else if (*position && *position != '\n') return -1;
+    }
+    return count;
+}
+
+int cpu_allowed(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &set) == -1) return 0;
+    return cpu >= 0 && cpu < CPU_SETSIZE && CPU_ISSET(cpu, &set);
+}
+
+// read a cpu list file of sysfs, returns count or -1 if it can't be read
+int read_sysfs_cpu_list(const char * path, int * cpus, int max) {
+    FILE * file = fopen(path, "r");
+    if (!file) return -1;
+    char list[MAX_SYSFS_LIST_LENGTH];
+    int count = fgets(list, sizeof(list), file) ? parse_cpu_list(list, cpus, max) : -1;
+    fclose(file);
+    return count;
+}
+
+// by group, then first hardware threads of all cores before second ones, then cpu
+int compare_placement(const void * a, const void * b) {
+    const struct Placement * x = a, * y = b;
+    if (x->group != y->group) return x->group - y->group;
+    if (x->rank != y->rank) return x->rank - y->rank;
+    return x->cpu - y->cpu;
+}
+
+int sibling_cpus(int * cpus, int max) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &set) == -1) return 0;
+
+    struct Placement * placements = malloc(CPU_SETSIZE * sizeof(struct Placement));
+    int * list = malloc(CPU_SETSIZE * sizeof(int));
+    int count = 0;
+    for (int cpu = 0 ; cpu < CPU_SETSIZE ; ++cpu) {
+        if (!CPU_ISSET(cpu, &set)) continue;
+        struct Placement * placement = &placements[count++];
+        placement->cpu = placement->group = cpu;
+        placement->rank = 0;
+
+        // hardware threads of the same core
+        char path[MAX_SYSFS_LIST_LENGTH];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+        int threads = read_sysfs_cpu_list(path, list, CPU_SETSIZE);
+        for (int index = 0 ; index < threads ; ++index) if (list[index] == cpu) placement->rank = index;
+        if (threads < 1) threads = 1;
+
+        // lowest cache shared beyond the core, L1 and private L2 are skipped by their count
+        for (int index = 0 ; index < MAX_CACHE_INDEXES ; ++index) {
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu, index);
+            int shared = read_sysfs_cpu_list(path, list, CPU_SETSIZE);
+            if (shared == -1) break;
+            if (shared <= threads) continue;
+            placement->group = list[0];
+            break;
+        }
+    }
+    qsort(placements, count, sizeof(struct Placement), compare_placement);
+
+    // pair neighbours of each group, a cpu left alone in its group goes to the end
+    int placed = 0, left = 0;
+    for (int index = 0 ; index < count ; ++index) {
+        int paired = index + 1 < count && placements[index + 1].group == placements[index].group;
+        if (paired) {
+            if (placed + 2 <= max) {
+                cpus[placed++] = placements[index].cpu;
+                cpus[placed++] = placements[index + 1].cpu;
+            }
+            ++index;
+        } else {
+            list[left++] = placements[index].cpu;
+        }
+    }
+    for (int index = 0 ; index < left && placed < max ; ++index) cpus[placed++] = list[index];
+
+    free(placements);
+    free(list);
+    return placed;
+}
+
+void pin_to_cpu(int cpu, cpu_set_t * previous) {
+    if (cpu == CPU_NONE) return;
+    if (previous && sched_getaffinity(0, sizeof(cpu_set_t), previous) == -1) {
+        printf("sched_getaffinity failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to get cpu affinity.\n", __progname);
+        exit(-1);
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    Sched_setaffinity(&set);
+}
+
+void restore_affinity(const cpu_set_t * previous) {
+    Sched_setaffinity(previous);
+}
+
+void set_thread_cpu(pthread_attr_t * attribute, int cpu) {
+    if (cpu == CPU_NONE) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_attr_setaffinity_np(attribute, sizeof(cpu_set_t), &set);
+}
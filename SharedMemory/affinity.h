@@ -0,0 +1,26 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <pthread.h>
+#include <sched.h>
+
+#define CPU_NONE -1 // not pinned, left to scheduler
+#define MAX_CPUS 1024 // max cpus of a cpu list
+
+// parse a cpu list such as "0,2,4-7" into cpus in given order, returns count or -1 if malformed
+int parse_cpu_list(const char * list, int * cpus, int max);
+// test if calling process is allowed to run on cpu
+int cpu_allowed(int cpu);
+// allowed cpus ordered for placement, each two consecutive ones are different cores sharing
+// the lowest level cache shared by more than one core(L2 cluster, else L3), pairs come first,
+// cpus left without a partner last, returns count
+int sibling_cpus(int * cpus, int max);
+
+// pin calling thread, or a child process before exec, to cpu, its previous cpus are stored if asked
+void pin_to_cpu(int cpu, cpu_set_t * previous);
+// put calling thread back on cpus stored by pin_to_cpu
+void restore_affinity(const cpu_set_t * previous);
+// set cpu of a thread to be created with attribute, nothing for CPU_NONE
+void set_thread_cpu(pthread_attr_t * attribute, int cpu);
+
+#endif
@@ -0,0 +1,135 @@
+// include system headers
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+// include own header
+#include "crc32c.h"
+
+#define CRC32C_POLYNOMIAL 0x82f63b78 // reversed Castagnoli polynomial
+
+// slicing-by-8 tables, table[0] is the classic byte-at-a-time table
+static uint32_t crc32c_table[8][256];
+static pthread_once_t crc32c_table_once = PTHREAD_ONCE_INIT; // put/get threads may both be first
+
+// private function list
+void crc32c_initialize_table(void);
+uint32_t crc32c_software(uint32_t crc, const unsigned char * bytes, size_t length);
+#if defined(__x86_64__)
+uint32_t crc32c_hardware(uint32_t crc, const unsigned char * bytes, size_t length);
+#endif
+uint32_t gf2_matrix_times(const uint32_t * matrix, uint32_t vector);
+void gf2_matrix_square(uint32_t * square, const uint32_t * matrix);
+
+void crc32c_initialize_table(void) {
+    for (int byte = 0 ; byte < 256 ; ++byte) {
+        uint32_t crc = byte;
+        for (int bit = 0 ; bit < 8 ; ++bit) crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLYNOMIAL : crc >> 1;
+        crc32c_table[0][byte] = crc;
+    }
+    // table[k] advances table[k - 1] by one more zero byte
+    for (int byte = 0 ; byte < 256 ; ++byte) {
+        for (int slice = 1 ; slice < 8 ; ++slice) {
+            uint32_t crc = crc32c_table[slice - 1][byte];
+            crc32c_table[slice][byte] = (crc >> 8) ^ crc32c_table[0][crc & 0xff];
+        }
+    }
+}
+
+// portable fallback, 8 bytes per step with slicing-by-8(little endian only)
+uint32_t crc32c_software(uint32_t crc, const unsigned char * bytes, size_t length) {
+    pthread_once(&crc32c_table_once, crc32c_initialize_table);
+    // byte at a time until aligned to 8 bytes
+    while (length && ((uintptr_t)bytes & 7)) {
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *bytes++) & 0xff];
+        --length;
+    }
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for ( ; length >= 8 ; bytes += 8, length -= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        word ^= crc;
+        crc = crc32c_table[7][word & 0xff] ^
+              crc32c_table[6][(word >> 8) & 0xff] ^
+              crc32c_table[5][(word >> 16) & 0xff] ^
+              crc32c_table[4][(word >> 24) & 0xff] ^
+              crc32c_table[3][(word >> 32) & 0xff] ^
+              crc32c_table[2][(word >> 40) & 0xff] ^
+              crc32c_table[1][(word >> 48) & 0xff] ^
+              crc32c_table[0][word >> 56];
+    }
+#endif
+    while (length--) crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *bytes++) & 0xff];
+    return crc;
+}
+
+#if defined(__x86_64__)
+// sse4.2 crc32 instruction, 8 bytes per instruction
+__attribute__((target("sse4.2")))
+uint32_t crc32c_hardware(uint32_t crc, const unsigned char * bytes, size_t length) {
+    uint64_t crc64 = crc;
+    while (length && ((uintptr_t)bytes & 7)) {
+        crc64 = _mm_crc32_u8(crc64, *bytes++);
+        --length;
+    }
+    for ( ; length >= 8 ; bytes += 8, length -= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    while (length--) crc64 = _mm_crc32_u8(crc64, *bytes++);
+    return crc64;
+}
+#endif
+
+uint32_t crc32c_update(uint32_t crc, const void * data, size_t length) {
+    // pre and post conditioning so that crcs can be chained and combined
+    crc = ~crc;
+#if defined(__x86_64__)
+    // cpu features are filled in by libgcc constructor before main, so checking them here is
+    // only a load and races with no other thread
+    if (__builtin_cpu_supports("sse4.2")) return ~crc32c_hardware(crc, data, length);
+#endif
+    return ~crc32c_software(crc, data, length);
+}
+
+// multiply matrix over GF(2) by vector
+uint32_t gf2_matrix_times(const uint32_t * matrix, uint32_t vector) {
+    uint32_t sum = 0;
+    for ( ; vector ; vector >>= 1, ++matrix) if (vector & 1) sum ^= *matrix;
+    return sum;
+}
+
+void gf2_matrix_square(uint32_t * square, const uint32_t * matrix) {
+    for (int n = 0 ; n < 32 ; ++n) square[n] = gf2_matrix_times(matrix, matrix[n]);
+}
+
+// same as zlib's crc32_combine, appends length2 zero bytes to crc1 by repeated squaring
+// of the one-zero-bit operator, then adds crc2
+uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, size_t length2) {
+    if (length2 == 0) return crc1;
+    uint32_t even[32], odd[32]; // operators for even and odd powers of two zero bits
+
+    // operator for one zero bit
+    odd[0] = CRC32C_POLYNOMIAL;
+    for (int n = 1, row = 1 ; n < 32 ; ++n, row <<= 1) odd[n] = row;
+    gf2_matrix_square(even, odd); // two zero bits
+    gf2_matrix_square(odd, even); // four zero bits
+
+    // first square gives operator for one zero byte
+    do {
+        gf2_matrix_square(even, odd);
+        if (length2 & 1) crc1 = gf2_matrix_times(even, crc1);
+        length2 >>= 1;
+        if (length2 == 0) break;
+        gf2_matrix_square(odd, even);
+        if (length2 & 1) crc1 = gf2_matrix_times(odd, crc1);
+        length2 >>= 1;
+    } while (length2);
+
+    return crc1 ^ crc2;
+}
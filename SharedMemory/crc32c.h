@@ -0,0 +1,14 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// crc32c(Castagnoli), same convention as zlib's crc32: start with 0, feed bytes in order
+// uses sse4.2 crc32 instruction when processor supports it, slicing-by-8 tables otherwise
+uint32_t crc32c_update(uint32_t crc, const void * data, size_t length);
+
+// crc of two consecutive ranges given crc of each and length of the second one
+uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, size_t length2);
+
+#endif
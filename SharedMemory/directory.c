@@ -0,0 +1,263 @@
+// nftw and utimensat need gnu extensions
+#define _GNU_SOURCE
+
+// include system headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include <ftw.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// include user headers
+#include "semaphore.h"
+#include "transfer.h"
+#include "affinity.h"
+
+// include own header
+#include "directory.h"
+
+extern const char * __progname; // gcc defined as substitute for argv[0]
+
+extern int verbose_flag; // verbose flag
+
+extern int buffer_number; // buffer number
+
+#define MAX_OPEN_DIRECTORIES 64 // descriptors nftw may keep open
+#define NO_MORE_FILES SIZE_MAX // handed from put to get when queue is empty
+
+// a walked file, directory or symlink
+struct Entry {
+    char * source; // path in source tree
+    char * dest; // path in dest tree
+    off_t size; // size of regular file
+    mode_t mode; // type and permission bits
+    struct timespec atime, mtime; // access and modification time
+};
+
+// a long-lived put/get pair, put claims files and hands their queue index to get in order
+// put is never more than buffer number + 1 files ahead of get, every file put has finished
+// but get hasn't started holds at least its empty slot in ring buffer
+struct Pair {
+    struct Transfer put, get;
+    size_t * pending; // queue indexes claimed by put and not yet started by get
+    size_t head, tail; // pop and push position of pending
+    pthread_mutex_t mutex;
+    pthread_cond_t claimed; // get waits for put to claim a file
+    pthread_t threads[2];
+};
+
+// walked entries in walk(pre) order, regular files are also listed in queue
+static struct Entry * entries;
+static size_t entry_count, entry_capacity;
+static size_t * queue; // entry indexes of regular files
+static size_t queue_count, queue_capacity;
+static size_t queue_next; // next file to claim, taken with atomic add
+static size_t directory_count;
+static off_t queued_size;
+static const char * source_root, * dest_root;
+
+// private function list
+void * grow(void * array, size_t * capacity, size_t size);
+char * dest_path(const char * path);
+int walk_entry(const char * path, const struct stat * file_stat, int flag, struct FTW * ftw);
+size_t claim_file(void);
+void * put_files(void * argument);
+void * get_files(void * argument);
+void apply_entry(struct Entry * entry);
+
+// double capacity of array once it is full
+void * grow(void * array, size_t * capacity, size_t size) {
+    *capacity = *capacity ? *capacity * 2 : 1024;
+    if ((array = realloc(array, *capacity * size)) == NULL) {
+        printf("realloc failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to grow file list.\n", __progname);
+        exit(-1);
+    }
+    return array;
+}
+
+// path under dest root matching path under source root
+char * dest_path(const char * path) {
+    const char * relative = path + strlen(source_root);
+    char * dest = malloc(strlen(dest_root) + strlen(relative) + 1);
+    strcpy(dest, dest_root);
+    strcat(dest, relative);
+    return dest;
+}
+
+// nftw callback, directories and symlinks are created right away, files only queued
+int walk_entry(const char * path, const struct stat * file_stat, int flag, struct FTW * ftw) {
+    if (flag == FTW_NS || flag == FTW_DNR) {
+        printf("%s: cannot access %s, skipped.\n", __progname, path);
+        return 0;
+    }
+    if (!S_ISREG(file_stat->st_mode) && !S_ISDIR(file_stat->st_mode) && !S_ISLNK(file_stat->st_mode)) {
+        if (verbose_flag) printf("%s: %s is not a regular file, directory or symlink, skipped.\n", __progname, path);
+        return 0;
+    }
+
+    if (entry_count == entry_capacity) entries = grow(entries, &entry_capacity, sizeof(struct Entry));
+    struct Entry * entry = &entries[entry_count];
+    entry->source = strdup(path);
+    entry->dest = dest_path(path);
+    entry->size = file_stat->st_size;
+    entry->mode = file_stat->st_mode;
+    entry->atime = file_stat->st_atim;
+    entry->mtime = file_stat->st_mtim;
+
+    if (S_ISDIR(file_stat->st_mode)) {
+        // owner must be able to write into it until metadata is applied
+        if (mkdir(entry->dest, S_IRWXU) == -1 && errno != EEXIST) {
+            printf("mkdir failed: %s.\n", strerror(errno));
+            if (verbose_flag) printf("%s: failed to create directory %s.\n", __progname, entry->dest);
+            exit(-1);
+        }
+        ++directory_count;
+    } else if (S_ISLNK(file_stat->st_mode)) {
+        char target[PATH_MAX];
+        ssize_t length = readlink(path, target, sizeof(target) - 1);
+        if (length == -1) {
+            printf("readlink failed: %s.\n", strerror(errno));
+            if (verbose_flag) printf("%s: failed to read symlink %s.\n", __progname, path);
+            exit(-1);
+        }
+        target[length] = '\0';
+        unlink(entry->dest);
+        if (symlink(target, entry->dest) == -1) {
+            printf("symlink failed: %s.\n", strerror(errno));
+            if (verbose_flag) printf("%s: failed to create symlink %s.\n", __progname, entry->dest);
+            exit(-1);
+        }
+    } else {
+        if (queue_count == queue_capacity) queue = grow(queue, &queue_capacity, sizeof(size_t));
+        queue[queue_count++] = entry_count;
+        queued_size += entry->size;
+    }
+    ++entry_count;
+    return 0;
+}
+
+off_t walk_directory(const char * source, const char * dest) {
+    source_root = source;
+    dest_root = dest;
+    // physical walk, symlinks are copied as symlinks instead of followed
+    if (nftw(source, walk_entry, MAX_OPEN_DIRECTORIES, FTW_PHYS) == -1) {
+        printf("nftw failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to walk directory %s.\n", __progname, source);
+        exit(-1);
+    }
+    if (verbose_flag) printf("%s: %zu files queued in %zu directories.\n", __progname, queue_count, directory_count);
+    return queued_size;
+}
+
+// take next file off queue, NO_MORE_FILES once it's empty
+size_t claim_file(void) {
+    size_t next = __atomic_fetch_add(&queue_next, 1, __ATOMIC_RELAXED);
+    return next < queue_count ? next : NO_MORE_FILES;
+}
+
+// claim files until queue is empty, put each of them to ring buffer after telling get which one it is
+void * put_files(void * argument) {
+    struct Pair * pair = argument;
+    for (;;) {
+        size_t next = claim_file();
+        pthread_mutex_lock(&pair->mutex);
+        pair->pending[pair->tail++ % (buffer_number + 1)] = next;
+        pthread_cond_signal(&pair->claimed);
+        pthread_mutex_unlock(&pair->mutex);
+        if (next == NO_MORE_FILES) break;
+
+        struct Entry * entry = &entries[queue[next]];
+        pair->put.file = entry->source;
+        pair->put.offset = 0;
+        pair->put.length = entry->size;
+        put_range(&pair->put);
+    }
+    return NULL;
+}
+
+// get files in the order put claimed them
+void * get_files(void * argument) {
+    struct Pair * pair = argument;
+    for (;;) {
+        pthread_mutex_lock(&pair->mutex);
+        while (pair->head == pair->tail) pthread_cond_wait(&pair->claimed, &pair->mutex);
+        size_t next = pair->pending[pair->head++ % (buffer_number + 1)];
+        pthread_mutex_unlock(&pair->mutex);
+        if (next == NO_MORE_FILES) break;
+
+        struct Entry * entry = &entries[queue[next]];
+        pair->get.file = entry->dest;
+        pair->get.source = entry->source;
+        pair->get.offset = 0;
+        pair->get.length = entry->size;
+        get_range(&pair->get);
+    }
+    return NULL;
+}
+
+void copy_files(struct RingBuffer ** ring_buffers, int * semids, int pairs, const int * cpus) {
+    struct Pair * pair_list = calloc(pairs, sizeof(struct Pair));
+    for (int index = 0 ; index < pairs ; ++index) {
+        struct Pair * pair = &pair_list[index];
+        pair->put.ring_buffer = pair->get.ring_buffer = ring_buffers[index];
+        pair->put.semid = pair->get.semid = semids[index];
+        pair->get.create = 1; // dest files aren't preallocated
+        pair->pending = malloc((buffer_number + 1) * sizeof(size_t));
+        pthread_mutex_init(&pair->mutex, NULL);
+        pthread_cond_init(&pair->claimed, NULL);
+        pthread_attr_t put_attribute, get_attribute;
+        pthread_attr_init(&put_attribute);
+        pthread_attr_init(&get_attribute);
+        set_thread_cpu(&put_attribute, cpus[index * 2]);
+        set_thread_cpu(&get_attribute, cpus[index * 2 + 1]);
+        if (pthread_create(&pair->threads[0], &put_attribute, put_files, pair) != 0 ||
+            pthread_create(&pair->threads[1], &get_attribute, get_files, pair) != 0) {
+            printf("pthread_create failed.\n");
+            if (verbose_flag) printf("%s: failed to create put/get threads.\n", __progname);
+            exit(-1);
+        }
+        pthread_attr_destroy(&put_attribute);
+        pthread_attr_destroy(&get_attribute);
+    }
+    for (int index = 0 ; index < pairs ; ++index) {
+        struct Pair * pair = &pair_list[index];
+        pthread_join(pair->threads[0], NULL);
+        pthread_join(pair->threads[1], NULL);
+        pthread_cond_destroy(&pair->claimed);
+        pthread_mutex_destroy(&pair->mutex);
+        free(pair->pending);
+    }
+    free(pair_list);
+}
+
+// failures only lose metadata, not contents, so they are reported and skipped
+void apply_entry(struct Entry * entry) {
+    struct timespec times[2] = {entry->atime, entry->mtime};
+    if (!S_ISLNK(entry->mode) && chmod(entry->dest, entry->mode & 07777) == -1) {
+        printf("%s: failed to set mode of %s, %s.\n", __progname, entry->dest, strerror(errno));
+    }
+    if (utimensat(AT_FDCWD, entry->dest, times, AT_SYMLINK_NOFOLLOW) == -1) {
+        printf("%s: failed to set times of %s, %s.\n", __progname, entry->dest, strerror(errno));
+    }
+}
+
+void apply_metadata(void) {
+    // reverse walk order, a directory's mtime is only set once nothing is created inside it anymore
+    for (size_t index = entry_count ; index > 0 ; --index) apply_entry(&entries[index - 1]);
+    if (verbose_flag) printf("%s: metadata of %zu entries applied.\n", __progname, entry_count);
+}
+
+size_t number_of_files(void) {
+    return queue_count;
+}
+
+size_t number_of_directories(void) {
+    return directory_count;
+}
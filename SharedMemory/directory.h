@@ -0,0 +1,25 @@
+#ifndef DIRECTORY_H
+#define DIRECTORY_H
+
+#include <sys/types.h>
+
+#include "ring-buffer.h"
+
+// directory mode, source tree is walked once up front and its regular files are queued,
+// a fixed set of put/get thread pairs take files off the queue and reuse their ring buffers,
+// dest directories and symlinks are created during the walk, mode and mtime are applied
+// in one pass after all contents are written
+
+// walk source tree into dest, returns total size of queued files
+off_t walk_directory(const char * source, const char * dest);
+// copy queued files with one put/get thread pair per ring buffer, returns once all are copied
+// put/get threads of pair i are pinned to cpus[2i]/cpus[2i + 1] unless they are CPU_NONE
+void copy_files(struct RingBuffer ** ring_buffers, int * semids, int pairs, const int * cpus);
+// apply mode and mtime of everything walked, children before their directories
+void apply_metadata(void);
+
+// number of regular files and directories walked
+size_t number_of_files(void);
+size_t number_of_directories(void);
+
+#endif
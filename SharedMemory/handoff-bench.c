@@ -0,0 +1,563 @@
+// SYS_futex and pthread_attr_setaffinity_np need gnu extensions
+#define _GNU_SOURCE
+
+// include system headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/ipc.h>
+#include <sys/sem.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <time.h>
+
+// include user headers
+#include "affinity.h" // cpu placement
+#include "ring-buffer.h" // spin-then-futex ring buffer
+
+// const definition
+#define DEFAULT_PRIMITIVES "sem,cond,futex,eventfd,pipe,spin,ring" // default primitives
+#define DEFAULT_MODES "process,thread" // default modes
+#define DEFAULT_ITERATIONS 100000 // default handoffs measured for each test
+#define DEFAULT_WARMUP 1000 // default round trips run before measuring
+#define DEFAULT_WINDOW 64 // default handoffs in flight in rate test
+
+#define MAX_ITERATIONS 10000000 // max handoffs measured for each test
+#define MAX_PLACEMENTS 16 // max --cpus placements
+#define MAX_LIST_LENGTH 256 // max length of a primitive/mode list
+#define SPIN_LIMIT 1024 // spin times before yielding(spin primitive only)
+
+// pause instruction to be polite to the sibling hyperthread while spinning
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() __asm__ __volatile__("" ::: "memory")
+#endif
+
+// synchronization primitives, each one makes a counting channel: every signal lets exactly one wait through
+#define PRIMITIVE_SEM 0 // System V semaphore, semop P/V(semaphore.c, ThreadCommunication)
+#define PRIMITIVE_COND 1 // process shared pthread mutex and condition variable around a counter
+#define PRIMITIVE_FUTEX 2 // counter word, waiter parks with FUTEX_WAIT and is woken only if it said so
+#define PRIMITIVE_EVENTFD 3 // eventfd in semaphore mode, each read takes 1
+#define PRIMITIVE_PIPE 4 // one byte written/read per handoff(ProcessControl)
+#define PRIMITIVE_SPIN 5 // atomic counter polled, spin then sched_yield like lock-free spsc
+#define PRIMITIVE_RING 6 // empty slots of a spin-then-futex ring buffer(ring-buffer.c, simple-cp -t 4)
+#define PRIMITIVES 7
+
+#define MODE_PROCESS 0 // two processes sharing an anonymous shared mapping
+#define MODE_THREAD 1 // two threads of this process
+#define MODES 2
+
+// global variables
+extern const char  * __progname; // gcc defined as substitute for argv[0]
+
+int verbose_flag = 0; // verbose flag
+
+// ring buffer of ring primitive, memfd so that side b's process inherits it
+key_t ipc_key = IPC_PRIVATE; // IPC key, unused by memfd
+int type = 4; // spin-then-futex
+int buffer_capacity = CACHE_LINE_SIZE, buffer_number; // slots carry no bytes, one for each handoff of a window
+int memory_backend = 2, huge_pages_flag, populate_flag; // memfd backend and its flags
+int direct_io_flag, stats_flag, stream_flag; // plain slots
+int consumers = 1; // side waiting on a channel is its only consumer
+int consumer_index = 0; // only consumer functions look at it
+
+int iterations = DEFAULT_ITERATIONS; // handoffs measured for each test
+int warmup = DEFAULT_WARMUP; // round trips run before measuring
+int window = DEFAULT_WINDOW; // handoffs in flight in rate test
+const char * output_file = NULL; // csv file, stdout if not given
+int primitive_flags[PRIMITIVES]; // primitives to run
+int mode_flags[MODES]; // modes to run
+int placements[MAX_PLACEMENTS][2]; // cpu of side a/b of each placement
+int placement_count = 0; // --cpus given, one unpinned placement if none
+
+const char * primitive_names[PRIMITIVES] = {"sem", "cond", "futex", "eventfd", "pipe", "spin", "ring"};
+const char * mode_names[MODES] = {"process", "thread"};
+
+// one direction of handoff, lives in shared memory
+struct Channel {
+    unsigned int count; // handoffs signalled but not waited for yet(futex, spin)
+    unsigned int waiting; // set while waiter is parked on count(futex)
+    pthread_mutex_t mutex; // protects count(cond)
+    pthread_cond_t cond; // signalled when count grows(cond)
+    int fds[2]; // read/write end of pipe, eventfd in both(eventfd, pipe)
+    int semid, semnum; // semaphore of this channel(sem)
+    int shmid; // memfd of ring buffer(ring)
+    struct RingBuffer * ring_buffer; // attached ring buffer(ring)
+};
+
+// state of one test shared by both sides
+// side a stamps the time, signals ping and waits for pong, side b waits for ping and signals pong
+// round trips are measured by side a, one-way handoffs by side b against a's stamp, both clocks
+// are CLOCK_MONOTONIC, which is the same on every cpu
+struct Bench {
+    int primitive;
+    struct Channel ping, pong;
+    long stamp; // nanoseconds when side a signalled ping
+    long rate_nanoseconds; // duration of rate test, measured by side a
+    long * one_way; // one-way latency of each handoff in nanoseconds, written by side b
+    long * round_trip; // round trip latency in nanoseconds, written by side a
+};
+
+// function list
+int parse_names(const char * text, const char ** names, int count, int * flags);
+int parse_primitives(const char * text);
+int parse_modes(const char * text);
+void parse_placement(const char * text);
+void help(int exit_number) __attribute__((noreturn));
+
+long now_nanoseconds(void);
+void Futex(unsigned int * word, int operation, unsigned int value);
+void channel_init(struct Channel * channel, int primitive, int semid, int semnum);
+void channel_destroy(struct Channel * channel, int primitive);
+void channel_signal(struct Channel * channel, int primitive);
+void channel_wait(struct Channel * channel, int primitive);
+
+void side_a(struct Bench * bench);
+void side_b(struct Bench * bench);
+void * side_b_thread(void * argument);
+int compare_nanoseconds(const void * a, const void * b);
+long percentile(long * sorted, int count, int per_mille);
+void benchmark(FILE * output, int primitive, int mode, int cpu_a, int cpu_b);
+
+// set flags of comma separated names, returns the number of names
+int parse_names(const char * text, const char ** names, int count, int * flags) {
+    if (strlen(text) >= MAX_LIST_LENGTH) {
+        printf("%s: list %s is too long.\n", __progname, text);
+        exit(-1);
+    }
+    char copy[MAX_LIST_LENGTH];
+    strcpy(copy, text);
+    for (int index = 0 ; index < count ; ++index) flags[index] = 0;
+    int parsed = 0;
+    for (char * token = strtok(copy, ",") ; token ; token = strtok(NULL, ",")) {
+        int index = 0;
+        while (index < count && strcmp(token, names[index]) != 0) ++index;
+        if (index == count) {
+            printf("%s: unknown name %s.\n", __progname, token);
+            exit(-1);
+        }
+        flags[index] = 1;
+        ++parsed;
+    }
+    if (parsed == 0) {
+        printf("%s: empty list.\n", __progname);
+        exit(-1);
+    }
+    return parsed;
+}
+
+// convert comma separated primitive names to flags
+int parse_primitives(const char * text) {
+    return parse_names(text, primitive_names, PRIMITIVES, primitive_flags);
+}
+
+// convert comma separated mode names to flags
+int parse_modes(const char * text) {
+    return parse_names(text, mode_names, MODES, mode_flags);
+}
+
+// add a placement of side a/b given as "A,B"
+void parse_placement(const char * text) {
+    int cpus[2];
+    if (placement_count == MAX_PLACEMENTS) {
+        printf("%s: at most %d placements.\n", __progname, MAX_PLACEMENTS);
+        exit(-1);
+    }
+    if (parse_cpu_list(text, cpus, 2) != 2) {
+        printf("%s: placement must be two cpus like 0,1, not %s.\n", __progname, text);
+        exit(-1);
+    }
+    for (int side = 0 ; side < 2 ; ++side) {
+        if (!cpu_allowed(cpus[side])) {
+            printf("%s: cpu %d is not available.\n", __progname, cpus[side]);
+            exit(-1);
+        }
+        placements[placement_count][side] = cpus[side];
+    }
+    ++placement_count;
+}
+
+// print help and exit with given number
+void help(int exit_number) {
+    printf("handoff-bench, measure handoff latency and rate of synchronization primitives between two processes or threads.\n");
+    printf("Usage: handoff-bench [options]\n");
+    printf("Writes csv with one row per primitive, mode and placement, latencies in nanoseconds.\n");
+    printf("Options:\n");
+    printf("-h, --help\tdisplay this help and exit\n");
+    printf("-v, --verbose\texplain what is being done\n");
+    printf("-o, --output\tcsv file, stdout by default\n");
+    printf("-i, --iterations\thandoffs measured for each test(default %d)\n", DEFAULT_ITERATIONS);
+    printf("--warmup\tround trips run before measuring(default %d)\n", DEFAULT_WARMUP);
+    printf("--window\thandoffs in flight before waiting for an ack in rate test(default %d)\n", DEFAULT_WINDOW);
+    printf("--primitives\tprimitives to run(default %s)\n", DEFAULT_PRIMITIVES);
+    printf("--modes\t\tmodes to run(default %s)\n", DEFAULT_MODES);
+    printf("--cpus\t\tpin side a/b to two cpus like 0,1, may be given several times to compare placements(unpinned by default)\n");
+    exit(exit_number);
+}
+
+long now_nanoseconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+// futex wrapper, not FUTEX_PRIVATE_FLAG since the word may live in memory shared between processes
+void Futex(unsigned int * word, int operation, unsigned int value) {
+    if (syscall(SYS_futex, word, operation, value, NULL, NULL, 0) == -1 && errno != EAGAIN && errno != EINTR) {
+        printf("futex failed: %s.\n", strerror(errno));
+        exit(-1);
+    }
+}
+
+// set up channel in shared memory, semaphore set is shared by both channels of a test
+void channel_init(struct Channel * channel, int primitive, int semid, int semnum) {
+    channel->count = channel->waiting = 0;
+    channel->fds[0] = channel->fds[1] = -1;
+    channel->semid = semid;
+    channel->semnum = semnum;
+    channel->shmid = -1;
+    if (primitive == PRIMITIVE_COND) {
+        pthread_mutexattr_t mutex_attribute;
+        pthread_condattr_t cond_attribute;
+        pthread_mutexattr_init(&mutex_attribute);
+        pthread_condattr_init(&cond_attribute);
+        pthread_mutexattr_setpshared(&mutex_attribute, PTHREAD_PROCESS_SHARED);
+        pthread_condattr_setpshared(&cond_attribute, PTHREAD_PROCESS_SHARED);
+        pthread_mutex_init(&channel->mutex, &mutex_attribute);
+        pthread_cond_init(&channel->cond, &cond_attribute);
+        pthread_mutexattr_destroy(&mutex_attribute);
+        pthread_condattr_destroy(&cond_attribute);
+    } else if (primitive == PRIMITIVE_EVENTFD) {
+        if ((channel->fds[0] = channel->fds[1] = eventfd(0, EFD_SEMAPHORE)) == -1) {
+            printf("eventfd failed: %s.\n", strerror(errno));
+            exit(-1);
+        }
+    } else if (primitive == PRIMITIVE_PIPE) {
+        if (pipe(channel->fds) == -1) {
+            printf("pipe failed: %s.\n", strerror(errno));
+            exit(-1);
+        }
+    } else if (primitive == PRIMITIVE_RING) {
+        // a whole window fits, signals of rate test never wait for space
+        buffer_number = window;
+        channel->shmid = create_ring_buffer();
+        channel->ring_buffer = attach_ring_buffer(channel->shmid);
+    }
+}
+
+void channel_destroy(struct Channel * channel, int primitive) {
+    if (primitive == PRIMITIVE_COND) {
+        pthread_mutex_destroy(&channel->mutex);
+        pthread_cond_destroy(&channel->cond);
+    }
+    if (primitive == PRIMITIVE_RING) {
+        deattach_ring_buffer(channel->ring_buffer);
+        delete_ring_buffer(channel->shmid);
+    }
+    if (channel->fds[0] != -1) close(channel->fds[0]);
+    if (channel->fds[1] != -1 && channel->fds[1] != channel->fds[0]) close(channel->fds[1]);
+}
+
+// one handoff, lets exactly one wait through
+void channel_signal(struct Channel * channel, int primitive) {
+    uint64_t one = 1;
+    struct sembuf ops = {.sem_num = channel->semnum, .sem_op = 1, .sem_flg = 0};
+    int result = 0;
+    switch (primitive) {
+        case PRIMITIVE_SEM:
+            while ((result = semop(channel->semid, &ops, 1)) == -1 && errno == EINTR);
+            break;
+        case PRIMITIVE_COND:
+            pthread_mutex_lock(&channel->mutex);
+            ++channel->count;
+            pthread_cond_signal(&channel->cond);
+            pthread_mutex_unlock(&channel->mutex);
+            break;
+        case PRIMITIVE_FUTEX:
+            // fence pairs with the waiter's store/load so that either waker sees the waiter or the waiter sees the count
+            __atomic_fetch_add(&channel->count, 1, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&channel->waiting, __ATOMIC_SEQ_CST)) Futex(&channel->count, FUTEX_WAKE, 1);
+            break;
+        case PRIMITIVE_EVENTFD:
+            result = write(channel->fds[1], &one, sizeof(one)) == sizeof(one) ? 0 : -1;
+            break;
+        case PRIMITIVE_PIPE:
+            result = write(channel->fds[1], &one, 1) == 1 ? 0 : -1;
+            break;
+        case PRIMITIVE_SPIN:
+            __atomic_fetch_add(&channel->count, 1, __ATOMIC_RELEASE);
+            break;
+        case PRIMITIVE_RING:
+            reserve_write_slot(channel->ring_buffer);
+            commit_write_slot(channel->ring_buffer, 0);
+            break;
+    }
+    if (result == -1) {
+        printf("%s signal failed: %s.\n", primitive_names[primitive], strerror(errno));
+        exit(-1);
+    }
+}
+
+// wait for one handoff
+void channel_wait(struct Channel * channel, int primitive) {
+    uint64_t value;
+    struct sembuf ops = {.sem_num = channel->semnum, .sem_op = -1, .sem_flg = 0};
+    int result = 0, spin = 0, size;
+    switch (primitive) {
+        case PRIMITIVE_SEM:
+            while ((result = semop(channel->semid, &ops, 1)) == -1 && errno == EINTR);
+            break;
+        case PRIMITIVE_COND:
+            pthread_mutex_lock(&channel->mutex);
+            while (channel->count == 0) pthread_cond_wait(&channel->cond, &channel->mutex);
+            --channel->count;
+            pthread_mutex_unlock(&channel->mutex);
+            break;
+        case PRIMITIVE_FUTEX:
+            // record waiter before checking count again so that signaller can't miss it
+            while (__atomic_load_n(&channel->count, __ATOMIC_ACQUIRE) == 0) {
+                __atomic_store_n(&channel->waiting, 1, __ATOMIC_SEQ_CST);
+                if (__atomic_load_n(&channel->count, __ATOMIC_SEQ_CST) == 0) Futex(&channel->count, FUTEX_WAIT, 0);
+                __atomic_store_n(&channel->waiting, 0, __ATOMIC_RELAXED);
+            }
+            __atomic_fetch_sub(&channel->count, 1, __ATOMIC_ACQ_REL);
+            break;
+        case PRIMITIVE_EVENTFD:
+            while ((result = read(channel->fds[0], &value, sizeof(value))) == -1 && errno == EINTR);
+            result = result == sizeof(value) ? 0 : -1;
+            break;
+        case PRIMITIVE_PIPE:
+            while ((result = read(channel->fds[0], &value, 1)) == -1 && errno == EINTR);
+            result = result == 1 ? 0 : -1;
+            break;
+        case PRIMITIVE_SPIN:
+            // give up processor if the other side is not running, two sides on one cpu would never meet otherwise
+            while (__atomic_load_n(&channel->count, __ATOMIC_ACQUIRE) == 0) {
+                if (++spin < SPIN_LIMIT) cpu_relax();
+                else { spin = 0; sched_yield(); }
+            }
+            __atomic_fetch_sub(&channel->count, 1, __ATOMIC_ACQ_REL);
+            break;
+        case PRIMITIVE_RING:
+            peek_read_slot(channel->ring_buffer, &size);
+            release_read_slot(channel->ring_buffer);
+            break;
+    }
+    if (result == -1) {
+        printf("%s wait failed: %s.\n", primitive_names[primitive], strerror(errno));
+        exit(-1);
+    }
+}
+
+// ping-pong for latency, then stream handoffs with an ack every window for rate
+void side_a(struct Bench * bench) {
+    int primitive = bench->primitive;
+    for (int index = 0 ; index < warmup + iterations ; ++index) {
+        long start = now_nanoseconds();
+        __atomic_store_n(&bench->stamp, start, __ATOMIC_RELAXED); // published by the handoff itself
+        channel_signal(&bench->ping, primitive);
+        channel_wait(&bench->pong, primitive);
+        if (index >= warmup) bench->round_trip[index - warmup] = now_nanoseconds() - start;
+    }
+
+    int handoffs = iterations / window * window;
+    long start = now_nanoseconds();
+    for (int index = 1 ; index <= handoffs ; ++index) {
+        channel_signal(&bench->ping, primitive);
+        if (index % window == 0) channel_wait(&bench->pong, primitive);
+    }
+    bench->rate_nanoseconds = now_nanoseconds() - start;
+}
+
+void side_b(struct Bench * bench) {
+    int primitive = bench->primitive;
+    for (int index = 0 ; index < warmup + iterations ; ++index) {
+        channel_wait(&bench->ping, primitive);
+        long end = now_nanoseconds();
+        if (index >= warmup) bench->one_way[index - warmup] = end - __atomic_load_n(&bench->stamp, __ATOMIC_RELAXED);
+        channel_signal(&bench->pong, primitive);
+    }
+
+    int handoffs = iterations / window * window;
+    for (int index = 1 ; index <= handoffs ; ++index) {
+        channel_wait(&bench->ping, primitive);
+        if (index % window == 0) channel_signal(&bench->pong, primitive);
+    }
+}
+
+void * side_b_thread(void * argument) {
+    side_b((struct Bench *)argument);
+    return NULL;
+}
+
+// qsort comparator for latencies
+int compare_nanoseconds(const void * a, const void * b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+// latency at per mille of sorted latencies, the slowest one within it
+long percentile(long * sorted, int count, int per_mille) {
+    return sorted[((long)count * per_mille + 999) / 1000 - 1];
+}
+
+// run one primitive in one mode and placement and write its csv row
+void benchmark(FILE * output, int primitive, int mode, int cpu_a, int cpu_b) {
+    // bench and its latencies are shared with side b's process in process mode
+    size_t size = sizeof(struct Bench) + 2 * sizeof(long) * iterations;
+    struct Bench * bench = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (bench == MAP_FAILED) {
+        printf("mmap failed: %s.\n", strerror(errno));
+        exit(-1);
+    }
+    bench->primitive = primitive;
+    bench->one_way = (long *)(bench + 1);
+    bench->round_trip = bench->one_way + iterations;
+
+    int semid = -1;
+    if (primitive == PRIMITIVE_SEM) {
+        // ping is semaphore 0 and pong semaphore 1, both start at 0
+        if ((semid = semget(IPC_PRIVATE, 2, IPC_CREAT | S_IRUSR | S_IWUSR)) == -1) {
+            printf("semget failed: %s.\n", strerror(errno));
+            exit(-1);
+        }
+    }
+    channel_init(&bench->ping, primitive, semid, 0);
+    channel_init(&bench->pong, primitive, semid, 1);
+    if (verbose_flag) printf("%s: running %s between %ss on cpu %d/%d.\n", __progname, primitive_names[primitive], mode_names[mode], cpu_a, cpu_b);
+
+    cpu_set_t previous;
+    pin_to_cpu(cpu_a, &previous);
+    if (mode == MODE_PROCESS) {
+        fflush(output);
+        pid_t pid = fork();
+        if (pid == -1) {
+            printf("fork failed: %s.\n", strerror(errno));
+            exit(-1);
+        }
+        if (pid == 0) {
+            pin_to_cpu(cpu_b, NULL);
+            side_b(bench);
+            _exit(0);
+        }
+        side_a(bench);
+        int status;
+        while (waitpid(pid, &status, 0) == -1 && errno == EINTR);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            printf("%s: side b of %s exited abnormally.\n", __progname, primitive_names[primitive]);
+            exit(-1);
+        }
+    } else {
+        pthread_t thread;
+        pthread_attr_t attribute;
+        pthread_attr_init(&attribute);
+        set_thread_cpu(&attribute, cpu_b);
+        if (pthread_create(&thread, &attribute, side_b_thread, bench) != 0) {
+            printf("pthread_create failed.\n");
+            exit(-1);
+        }
+        pthread_attr_destroy(&attribute);
+        side_a(bench);
+        pthread_join(thread, NULL);
+    }
+    if (cpu_a != CPU_NONE) restore_affinity(&previous);
+
+    channel_destroy(&bench->ping, primitive);
+    channel_destroy(&bench->pong, primitive);
+    if (semid != -1) semctl(semid, 0, IPC_RMID);
+
+    // rate counts streamed handoffs only, acks of each window come on top of them
+    qsort(bench->one_way, iterations, sizeof(long), compare_nanoseconds);
+    qsort(bench->round_trip, iterations, sizeof(long), compare_nanoseconds);
+    int handoffs = iterations / window * window;
+    double rate = bench->rate_nanoseconds ? handoffs * 1000000000.0 / bench->rate_nanoseconds : 0;
+    fprintf(output, "%s,%s,%d,%d,%d,%ld,%ld,%ld,%ld,%ld,%ld,%.0f\n",
+            primitive_names[primitive], mode_names[mode], cpu_a, cpu_b, iterations,
+            percentile(bench->one_way, iterations, 500), percentile(bench->one_way, iterations, 990), percentile(bench->one_way, iterations, 999),
+            percentile(bench->round_trip, iterations, 500), percentile(bench->round_trip, iterations, 990), percentile(bench->round_trip, iterations, 999),
+            rate);
+    fflush(output);
+    munmap(bench, size);
+}
+
+// program entry
+int main(int argc, char * argv[]) {
+    // option structs
+    static struct option options[] = {
+        {"help",        0,  NULL,   'h'},
+        {"verbose",     0,  NULL,   'v'},
+        {"output",      1,  NULL,   'o'},
+        {"iterations",  1,  NULL,   'i'},
+        {"warmup",      1,  NULL,   1},
+        {"window",      1,  NULL,   2},
+        {"primitives",  1,  NULL,   3},
+        {"modes",       1,  NULL,   4},
+        {"cpus",        1,  NULL,   5},
+        {0,             0,  0,      0}
+    };
+    parse_primitives(DEFAULT_PRIMITIVES);
+    parse_modes(DEFAULT_MODES);
+    // parse command line options
+    int opt;
+    while ((opt = getopt_long(argc, argv, "hvo:i:", options, NULL)) != -1) {
+        switch (opt) {
+            case 'v':   verbose_flag = 1;               break;
+            case 'o':   output_file = optarg;           break;
+            case 'i':   iterations = atoi(optarg);      break;
+            case 1:     warmup = atoi(optarg);          break;
+            case 2:     window = atoi(optarg);          break;
+            case 3:     parse_primitives(optarg);       break;
+            case 4:     parse_modes(optarg);            break;
+            case 5:     parse_placement(optarg);        break;
+            case 'h':   help(0);                        break;
+            case '?':   help(-1);                       break;
+        }
+    }
+    if (optind != argc) help(-1);
+    if (iterations <= 0 || iterations > MAX_ITERATIONS) {
+        printf("%s: iterations must between 1 and %d.\n", __progname, MAX_ITERATIONS);
+        exit(-1);
+    }
+    if (warmup < 0) {
+        printf("%s: warmup must not be negative.\n", __progname);
+        exit(-1);
+    }
+    // System V semaphores can't count beyond SEMVMX(32767), nor can a pipe hold much more than 64K bytes
+    if (window <= 0 || window > iterations || window > 4096) {
+        printf("%s: window must between 1 and iterations(at most 4096).\n", __progname);
+        exit(-1);
+    }
+    if (placement_count == 0) {
+        placements[0][0] = placements[0][1] = CPU_NONE;
+        placement_count = 1;
+    }
+
+    FILE * output = stdout;
+    if (output_file && (output = fopen(output_file, "w")) == NULL) {
+        printf("fopen failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to open file %s for writing.\n", __progname, output_file);
+        exit(-1);
+    }
+    fprintf(output, "primitive,mode,cpu_a,cpu_b,iterations,one_way_p50_ns,one_way_p99_ns,one_way_p999_ns,round_trip_p50_ns,round_trip_p99_ns,round_trip_p999_ns,handoffs_per_second\n");
+
+    for (int placement = 0 ; placement < placement_count ; ++placement)
+        for (int mode = 0 ; mode < MODES ; ++mode)
+            for (int primitive = 0 ; primitive < PRIMITIVES ; ++primitive)
+                if (mode_flags[mode] && primitive_flags[primitive])
+                    benchmark(output, primitive, mode, placements[placement][0], placements[placement][1]);
+
+    if (output != stdout) fclose(output);
+    return 0;
+}
@@ -0,0 +1,104 @@
+// copy_file_range and splice need gnu extensions
+#define _GNU_SOURCE
+
+// include system headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <sys/types.h>
+#include <sys/sendfile.h>
+
+// include own header
+#include "kernel-copy.h"
+
+#define KERNEL_COPY_CHUNK (8 * 1024 * 1024) // bytes copied per system call, keeps progress bar moving
+#define PIPE_SIZE (1024 * 1024) // pipe size requested for splice
+
+extern const char * __progname; // gcc defined as substitute for argv[0]
+
+extern int verbose_flag; // verbose flag
+
+// private function list
+ssize_t splice_through_pipe(int in_fd, int out_fd, off_t offset, size_t size, int pipe_fds[2]);
+int engine_unsupported(int error);
+
+// splice size bytes from in_fd to out_fd at offset through pipe
+// returns bytes spliced or -1 with errno set
+ssize_t splice_through_pipe(int in_fd, int out_fd, off_t offset, size_t size, int pipe_fds[2]) {
+    // lazily create the pipe on first use
+    if (pipe_fds[0] == -1) {
+        if (pipe(pipe_fds) == -1) return -1;
+        fcntl(pipe_fds[1], F_SETPIPE_SZ, PIPE_SIZE); // bigger pipe means less splice calls, best effort
+    }
+    loff_t in_offset = offset, out_offset = offset;
+    ssize_t in_pipe = splice(in_fd, &in_offset, pipe_fds[1], NULL, size, SPLICE_F_MOVE);
+    if (in_pipe <= 0) return in_pipe;
+    // drain everything in pipe to out_fd
+    for (ssize_t drained = 0, result ; drained < in_pipe ; drained += result) {
+        if ((result = splice(pipe_fds[0], NULL, out_fd, &out_offset, in_pipe - drained, SPLICE_F_MOVE)) == -1) {
+            if (errno == EINTR) { result = 0; continue; }
+            // data is stuck in pipe, can't fall back to another engine
+            printf("splice failed: %s.\n", strerror(errno));
+            if (verbose_flag) printf("%s: failed to splice from pipe to dest file.\n", __progname);
+            exit(-1);
+        }
+    }
+    return in_pipe;
+}
+
+// test if error means current engine can't be used with these files
+int engine_unsupported(int error) {
+    return error == ENOSYS || error == EXDEV || error == EINVAL || error == EOPNOTSUPP || error == EBADF;
+}
+
+void kernel_copy(int in_fd, int out_fd, off_t length, int engine, size_t * transferred) {
+    const char * names[] = {"ring", "copy_file_range", "splice", "sendfile"};
+    int pipe_fds[2] = {-1, -1}; // pipe for splice
+    off_t offset = 0; // bytes copied
+    while (offset < length) {
+        size_t chunk = length - offset < KERNEL_COPY_CHUNK ? length - offset : KERNEL_COPY_CHUNK;
+        ssize_t result = -1;
+        loff_t in_offset = offset, out_offset = offset;
+        switch (engine) {
+            case ENGINE_COPY_FILE_RANGE:
+                result = copy_file_range(in_fd, &in_offset, out_fd, &out_offset, chunk, 0);
+                break;
+            case ENGINE_SPLICE:
+                result = splice_through_pipe(in_fd, out_fd, offset, chunk, pipe_fds);
+                break;
+            case ENGINE_SENDFILE:
+                // sendfile writes at current file offset of out_fd
+                if (lseek(out_fd, offset, SEEK_SET) == -1) break;
+                result = sendfile(out_fd, in_fd, &in_offset, chunk);
+                break;
+        }
+        if (result == -1) {
+            if (errno == EINTR) continue;
+            // fall back to the next engine and copy the rest with it
+            if (engine_unsupported(errno) && engine < ENGINE_SENDFILE) {
+                if (verbose_flag) printf("%s: %s unsupported(%s), fall back to %s.\n", __progname, names[engine], strerror(errno), names[engine + 1]);
+                ++engine;
+                continue;
+            }
+            printf("%s failed: %s.\n", names[engine], strerror(errno));
+            if (verbose_flag) printf("%s: failed to copy file inside kernel.\n", __progname);
+            exit(-1);
+        }
+        // end of file before length, source file shrank since its size was taken
+        if (result == 0) {
+            printf("%s: source file shrank to %ld bytes while copying.\n", __progname, (long)offset);
+            exit(-1);
+        }
+        offset += result;
+        __atomic_store_n(transferred, offset, __ATOMIC_RELAXED);
+        if (verbose_flag) printf("%s: %zd bytes copied with %s.\n", __progname, result, names[engine]);
+    }
+    if (pipe_fds[0] != -1) {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef KERNEL_COPY_H
+#define KERNEL_COPY_H
+
+#include <sys/types.h>
+
+// engines, ring buffer engines(put/get processes) are not handled here
+#define ENGINE_RING 0
+#define ENGINE_COPY_FILE_RANGE 1
+#define ENGINE_SPLICE 2
+#define ENGINE_SENDFILE 3
+#define ENGINE_URING 4 // ring buffer, put/get do asynchronous io with io_uring
+
+#define ENGINE_USES_RING(engine) ((engine) == ENGINE_RING || (engine) == ENGINE_URING)
+
+// copy length bytes from in_fd to out_fd without passing through user space
+// falls back copy_file_range -> splice -> sendfile if an engine is not supported
+// transferred is updated after each chunk so that progress bar can follow
+// exits if source ends before length bytes, i.e. it shrank while being copied
+void kernel_copy(int in_fd, int out_fd, off_t length, int engine, size_t * transferred);
+
+#endif
@@ -0,0 +1,191 @@
+// cpu_set_t of affinity.h needs gnu extensions
+#define _GNU_SOURCE
+
+// include system headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+// include user headers
+#include "affinity.h"
+
+// include own header
+#include "progress.h"
+
+extern const char * __progname; // gcc defined as substitute for argv[0]
+
+extern int verbose_flag; // verbose flag
+
+#define PROGRESS_INTERVAL 200 // time interval(milli seconds) to redraw progress bar
+#define DEFAULT_COLUMNS 80 // columns used when window size is unknown
+#define MAX_BAR_WIDTH 512 // max columns of # and space
+#define RATE_SMOOTHING 0.5 // weight of latest interval in rate, the rest is kept from previous rate
+
+// progress state, only one progress bar at a time
+static const char * progress_name; // dest file name
+static size_t progress_total; // bytes to be transferred
+static struct RingBuffer ** progress_ring_buffers; // ring buffers to poll
+static int progress_count; // number of ring buffers
+static size_t * progress_kernel_transferred; // kernel engines' counter
+
+static pthread_t progress_thread; // thread redrawing progress bar
+static pthread_mutex_t progress_mutex = PTHREAD_MUTEX_INITIALIZER; // protects progress_stopped
+static pthread_cond_t progress_condition; // signaled by stop_progress to cut the sleep short
+static int progress_stopped; // set by stop_progress
+
+static volatile sig_atomic_t window_changed = 1; // set by SIGWINCH, window size is queried on first draw
+static int columns = DEFAULT_COLUMNS; // cached window width
+
+// private function list
+void window_change_handler(int sig);
+size_t progress_transferred(void);
+void format_duration(char * buffer, size_t length, double seconds);
+void draw_progress(size_t transferred, double rate);
+void * progress_loop(void * argument);
+
+// only set a flag, ioctl is left to progress thread
+void window_change_handler(int sig) {
+    window_changed = 1;
+}
+
+// bytes transferred so far, summed over all ring buffers and kernel engines
+// ring buffers' total_size lives on its own cache line, reading it doesn't disturb put/get
+// holes skipped in sparse copy count as transferred, otherwise bar never reaches the end
+size_t progress_transferred(void) {
+    size_t transferred = __atomic_load_n(progress_kernel_transferred, __ATOMIC_RELAXED);
+    for (int index = 0 ; index < progress_count ; ++index) {
+        transferred += number_of_bytes_transferred(progress_ring_buffers[index]);
+        transferred += number_of_bytes_skipped(progress_ring_buffers[index]);
+    }
+    return transferred;
+}
+
+// format seconds as h:mm:ss or m:ss
+void format_duration(char * buffer, size_t length, double seconds) {
+    long total = (long)(seconds + 0.5);
+    if (total >= 3600) snprintf(buffer, length, "%ld:%02ld:%02ld", total / 3600, total / 60 % 60, total % 60);
+    else snprintf(buffer, length, "%ld:%02ld", total / 60, total % 60);
+}
+
+// draw the whole line with one write
+void draw_progress(size_t transferred, double rate) {
+    // query window size only after it has changed
+    if (window_changed) {
+        window_changed = 0;
+        struct winsize window_size;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &window_size) == -1 || window_size.ws_col == 0) {
+            if (verbose_flag) printf("%s: failed to get console window's size, %s.\n", __progname, strerror(errno));
+            columns = DEFAULT_COLUMNS;
+        } else {
+            columns = window_size.ws_col;
+        }
+    }
+
+    // total is unknown(0) for pipes, show bytes transferred instead of percent and ETA
+    char suffix[64];
+    double percent = progress_total ? (double)transferred / progress_total : 0;
+    if (progress_total) {
+        char eta[16] = "--:--";
+        if (rate > 0 && transferred < progress_total) format_duration(eta, sizeof(eta), (progress_total - transferred) / rate);
+        if (transferred >= progress_total) format_duration(eta, sizeof(eta), 0);
+        snprintf(suffix, sizeof(suffix), " %3d%% %8.1f MB/s ETA %s", (int)(percent * 100), rate / 1024 / 1024, eta);
+    } else {
+        snprintf(suffix, sizeof(suffix), " %.1f MB %8.1f MB/s", transferred / 1024.0 / 1024, rate / 1024 / 1024);
+    }
+
+    // bar width excluding file name, " :[", "]", suffix and 1 preserved
+    int width = columns - (int)strlen(progress_name) - 4 - (int)strlen(suffix) - 1;
+    if (width < 0) width = 0;
+    if (width > MAX_BAR_WIDTH) width = MAX_BAR_WIDTH;
+    char bar[MAX_BAR_WIDTH + 1];
+    for (int count = 0 ; count < width ; ++count) bar[count] = count < width * percent ? '#' : ' ';
+    bar[width] = '\0';
+
+    printf("\r%s :[%s]%s", progress_name, bar, suffix);
+    fflush(stdout); // flush stdout explictly
+}
+
+// redraw every interval until stopped, rate is smoothed over intervals
+void * progress_loop(void * argument) {
+    struct timespec last, now, deadline;
+    clock_gettime(CLOCK_MONOTONIC, &last);
+    size_t last_transferred = progress_transferred(), transferred;
+    double rate = 0;
+
+    pthread_mutex_lock(&progress_mutex);
+    while (!progress_stopped) {
+        // sleep for interval unless stop_progress wakes us up
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_nsec += PROGRESS_INTERVAL * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        while (!progress_stopped && pthread_cond_timedwait(&progress_condition, &progress_mutex, &deadline) != ETIMEDOUT);
+        if (progress_stopped) break;
+        pthread_mutex_unlock(&progress_mutex);
+
+        // instantaneous rate of latest interval, smoothed so that ETA doesn't jump around
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        transferred = progress_transferred();
+        double seconds = (now.tv_sec - last.tv_sec) + (now.tv_nsec - last.tv_nsec) / 1000000000.0;
+        double current = seconds > 0 ? (transferred - last_transferred) / seconds : 0;
+        rate = rate > 0 ? RATE_SMOOTHING * current + (1 - RATE_SMOOTHING) * rate : current;
+        last = now;
+        last_transferred = transferred;
+        draw_progress(transferred, rate);
+
+        pthread_mutex_lock(&progress_mutex);
+    }
+    pthread_mutex_unlock(&progress_mutex);
+
+    // final bar with what has really been transferred
+    draw_progress(progress_transferred(), rate);
+    putchar('\n');
+    return NULL;
+}
+
+void start_progress(const char * name, size_t total, struct RingBuffer ** ring_buffers, int count, size_t * kernel_transferred, int cpu) {
+    progress_name = name;
+    progress_total = total;
+    progress_ring_buffers = ring_buffers;
+    progress_count = count;
+    progress_kernel_transferred = kernel_transferred;
+    progress_stopped = 0;
+
+    // SA_RESTART so that SIGWINCH doesn't interrupt waiting for child processes
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = window_change_handler;
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGWINCH, &action, NULL);
+
+    // timed wait uses monotonic clock, same as deadline
+    pthread_condattr_t attribute;
+    pthread_condattr_init(&attribute);
+    pthread_condattr_setclock(&attribute, CLOCK_MONOTONIC);
+    pthread_cond_init(&progress_condition, &attribute);
+    pthread_condattr_destroy(&attribute);
+
+    pthread_attr_t thread_attribute;
+    pthread_attr_init(&thread_attribute);
+    set_thread_cpu(&thread_attribute, cpu);
+    pthread_create(&progress_thread, &thread_attribute, progress_loop, NULL);
+    pthread_attr_destroy(&thread_attribute);
+}
+
+void stop_progress(void) {
+    pthread_mutex_lock(&progress_mutex);
+    progress_stopped = 1;
+    pthread_cond_signal(&progress_condition);
+    pthread_mutex_unlock(&progress_mutex);
+
+    pthread_join(progress_thread, NULL);
+    pthread_cond_destroy(&progress_condition);
+    signal(SIGWINCH, SIG_DFL);
+}
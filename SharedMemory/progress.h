@@ -0,0 +1,15 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <sys/types.h>
+
+#include "ring-buffer.h"
+
+// progress bar of dest file, redrawn by a thread on a coarse timer
+// bytes transferred are summed from ring buffers' total_size and kernel engines' counter,
+// window size is cached and only queried again after SIGWINCH, thread is pinned to cpu unless it's CPU_NONE
+void start_progress(const char * name, size_t total, struct RingBuffer ** ring_buffers, int count, size_t * kernel_transferred, int cpu);
+// draw the final bar and stop the thread
+void stop_progress(void);
+
+#endif
@@ -1,13 +1,23 @@
+// memfd_create and MAP_POPULATE need gnu extensions
+#define _GNU_SOURCE
+
 // include system headers
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <errno.h>
 #include <string.h>
+#include <sched.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <linux/futex.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/shm.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 
 // include own header
 #include "ring-buffer.h"
@@ -21,10 +31,71 @@ extern int type; // implementation type
 extern int buffer_capacity; // buffer capacity
 extern int buffer_number; // buffer number
 
+extern int memory_backend; // shared memory backend
+extern int huge_pages_flag; // huge pages flag
+extern int populate_flag; // prefault flag
+extern int direct_io_flag; // direct io flag
+extern int stats_flag; // stats flag
+extern int stream_flag; // stream flag
+extern int consumers; // consumers of each ring buffer, more than one in tee mode
+extern int consumer_index; // consumer of calling process, PRODUCER for producer
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024) // ring buffer size is rounded up to huge page size
+#define MAX_SHM_NAME_LENGTH 32 // max posix shared memory object name length
+#define MAX_STATS_NAME_LENGTH 32 // max name of a latency histogram
+#define RING_BUFFER_FD_ENVIRONMENT "SIMPLE_CP_RING_BUFFER_FD" // memfd inherited by put/get processes
+
+#define SPIN_LIMIT 1024 // spin times before yielding(lock-free spsc) or parking(spin-then-futex)
+
+// pause instruction to be polite to the sibling hyperthread while spinning
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() __asm__ __volatile__("" ::: "memory")
+#endif
+
 // private function list, all wrapper functions
 int Shmget(key_t key, size_t size, int shmflg);
 void * Shmat(int shmid, const void * shmaddr, int shmflg);
 void Shmdt(const void * shmaddr);
+int Shm_open(const char * name, int oflag, mode_t mode);
+int Memfd_create(const char * name, unsigned int flags);
+void Ftruncate(int fd, off_t length);
+void * Mmap(size_t length, int flags, int fd);
+
+// private function list, shared memory backend helpers
+size_t ring_buffer_size(void);
+size_t slot_stride(void);
+size_t slot_offset(void);
+size_t stream_size(void);
+void shm_name(key_t key, char * name);
+void initialize_ring_buffer(struct RingBuffer * buffer);
+
+// private function list, slot address helper
+struct BufferEntry * get_buffer_entry(struct RingBuffer * ring_buffer, size_t index);
+char * get_buffer_bytes(struct RingBuffer * ring_buffer, size_t index);
+char * get_stream_bytes(struct RingBuffer * ring_buffer, size_t index);
+
+// private function list, tee helper
+size_t slowest_out(struct RingBuffer * ring_buffer, int order);
+
+// private function list, lock-free spsc helpers
+void spsc_wait_for_space(struct RingBuffer * ring_buffer, size_t in, size_t needed, size_t limit);
+void spsc_wait_for_data(struct RingBuffer * ring_buffer, size_t out);
+
+// private function list, spin-then-futex helpers
+void futex_wait(unsigned int * word, unsigned int value);
+void futex_wake(unsigned int * word);
+void hybrid_wait_for_space(struct RingBuffer * ring_buffer, size_t in, size_t needed, size_t limit);
+void hybrid_wait_for_data(struct RingBuffer * ring_buffer, size_t out);
+void hybrid_wake(unsigned int * waiting, unsigned int * event);
+
+// private function list, statistics helpers
+int space_stalled(struct RingBuffer * ring_buffer, size_t in, size_t needed, size_t limit);
+int data_stalled(struct RingBuffer * ring_buffer, size_t out);
+size_t elapsed_nanoseconds(struct timespec * start);
+void sample_occupancy(struct RingBuffer * ring_buffer);
+void print_latency_histogram(const char * name, struct RingBufferStats * stats);
 
 // shmget wrapper
 int Shmget(key_t key, size_t size, int shmflg) {
@@ -56,43 +127,217 @@ void Shmdt(const void * shmaddr) {
     }
 }
 
+// shm_open wrapper
+int Shm_open(const char * name, int oflag, mode_t mode) {
+    int fd = -1;
+    if ((fd = shm_open(name, oflag, mode)) == -1) {
+        printf("shm_open failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to open posix shared memory object %s.\n", __progname, name);
+        exit(-1);
+    }
+    return fd;
+}
+
+// memfd_create wrapper
+int Memfd_create(const char * name, unsigned int flags) {
+    int fd = -1;
+    if ((fd = memfd_create(name, flags)) == -1) {
+        printf("memfd_create failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to create anonymous memory file.\n", __progname);
+        exit(-1);
+    }
+    return fd;
+}
+
+// ftruncate wrapper
+void Ftruncate(int fd, off_t length) {
+    if (ftruncate(fd, length) == -1) {
+        printf("ftruncate failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to set size of shared memory to %ld.\n", __progname, (long)length);
+        exit(-1);
+    }
+}
+
+// mmap wrapper, always maps a readable and writable region
+void * Mmap(size_t length, int flags, int fd) {
+    void * ptr = MAP_FAILED;
+    if ((ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, flags, fd, 0)) == MAP_FAILED) {
+        printf("mmap failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to map shared memory to current address space.\n", __progname);
+        exit(-1);
+    }
+    return ptr;
+}
+
+// slots start on cache line boundary, or page boundary for O_DIRECT
+size_t slot_alignment(void) {
+    static size_t page_size = 0;
+    if (!direct_io_flag) return CACHE_LINE_SIZE;
+    if (page_size == 0) page_size = sysconf(_SC_PAGESIZE);
+    return page_size;
+}
+
+// distance between two slots, buffer capacity rounded up to slot alignment
+size_t slot_stride(void) {
+    size_t alignment = slot_alignment();
+    return (buffer_capacity + alignment - 1) / alignment * alignment;
+}
+
+// offset of the first slot, after ring buffer header and all descriptors
+size_t slot_offset(void) {
+    size_t alignment = slot_alignment();
+    return (sizeof(struct RingBuffer) + sizeof(struct BufferEntry) * buffer_number + alignment - 1) / alignment * alignment;
+}
+
+// size of stream ring, room for buffer_number records of buffer capacity
+size_t stream_size(void) {
+    size_t size = buffer_number * (STREAM_HEADER_SIZE + STREAM_ALIGN(buffer_capacity));
+    return (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+}
+
+// size for ring buffer, rounded up to huge page size if huge pages are required
+size_t ring_buffer_size(void) {
+    size_t size = slot_offset() + (stream_flag ? stream_size() : slot_stride() * buffer_number);
+    if (huge_pages_flag) size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    return size;
+}
+
+// posix shared memory object name derived from IPC key
+void shm_name(key_t key, char * name) {
+    snprintf(name, MAX_SHM_NAME_LENGTH, "/simple-cp-%x", key);
+}
+
 // create ring buffer and return its shared memory id
+// 0 - System V shared memory, shmid is returned
+// 1 - posix shm_open, file descriptor is returned and object is named after IPC key
+// 2 - memfd_create, file descriptor is returned and inherited by put/get processes,
+//     nothing is left behind even if all processes crashed
 int create_ring_buffer(void) {
     // size for ring buffer to be created
-    size_t size = sizeof(struct RingBuffer) + (sizeof(struct BufferEntry) + buffer_capacity) * buffer_number;
-    // apply for shared memory segment
-    int shmid = Shmget(ipc_key, size, IPC_CREAT | S_IRUSR | S_IWUSR);
+    size_t size = ring_buffer_size();
+    int shmid = -1;
+    if (memory_backend == 0) {
+        // apply for shared memory segment
+        shmid = Shmget(ipc_key, size, IPC_CREAT | S_IRUSR | S_IWUSR | (huge_pages_flag ? SHM_HUGETLB : 0));
+    } else if (memory_backend == 1) {
+        // create named posix shared memory object
+        char name[MAX_SHM_NAME_LENGTH];
+        shm_name(ipc_key, name);
+        shmid = Shm_open(name, O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+        Ftruncate(shmid, size);
+    } else {
+        // create anonymous memory file without close-on-exec, put/get processes inherit it
+        shmid = Memfd_create("simple-cp", huge_pages_flag ? MFD_HUGETLB : 0);
+        Ftruncate(shmid, size);
+    }
     if (verbose_flag) printf("%s: shared memory for ring buffer applied.\n", __progname);
 
     // attach ring buffer(shmid(int) -> ring_buffer(struct RingBuffer *))
-    struct RingBuffer * buffer = Shmat(shmid, NULL, SHM_R | SHM_W);
+    struct RingBuffer * buffer = attach_ring_buffer(shmid);
     if (verbose_flag) printf("%s: ring buffer attached.\n", __progname);
 
+    initialize_ring_buffer(buffer);
+
+    // deattach ring buffer
+    deattach_ring_buffer(buffer);
+
+    return shmid;
+}
+
+// in-process ring buffer for threads, a private anonymous mapping needs no IPC key or descriptor
+struct RingBuffer * create_private_ring_buffer(void) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | (huge_pages_flag ? MAP_HUGETLB : 0) | (populate_flag ? MAP_POPULATE : 0);
+    struct RingBuffer * buffer = Mmap(ring_buffer_size(), flags, -1);
+    if (verbose_flag) printf("%s: private ring buffer mapped.\n", __progname);
+
+    initialize_ring_buffer(buffer);
+
+    return buffer;
+}
+
+void delete_private_ring_buffer(struct RingBuffer * ring_buffer) {
+    munmap(ring_buffer, ring_buffer_size());
+}
+
+// set default state of a newly created ring buffer
+void initialize_ring_buffer(struct RingBuffer * buffer) {
     // set default in/out
     buffer->in = 0;
-    buffer->out = 0;
+    buffer->cached_out = 0;
+    buffer->reserved = 0;
+    // set default futex words
+    buffer->space_event = 0;
+    buffer->producer_waiting = 0;
+    // set default digests
+    buffer->source_size = 0;
+    buffer->source_digest = 0;
+    // set default consumer lines
+    for (int index = 0 ; index < MAX_CONSUMERS ; ++index) {
+        struct RingBufferConsumer * consumer = &buffer->consumer[index];
+        consumer->out = 0;
+        consumer->cached_in = 0;
+        consumer->peeked = 0;
+        consumer->data_event = 0;
+        consumer->consumer_waiting = 0;
+        consumer->total_size = 0;
+        consumer->skipped_size = 0;
+        consumer->dest_digest = 0;
+    }
 
     if (verbose_flag) printf("%s: ring buffer initialized.\n", __progname);
+}
 
-    // deattach ring buffer
-    Shmdt(buffer);
-
-    return shmid;
+// export ring buffer to put/get processes forked afterwards
+// only memfd needs it, its descriptor number is passed through environment
+void export_ring_buffer(int shmid) {
+    if (memory_backend != 2) return;
+    char fd_string[MAX_SHM_NAME_LENGTH];
+    snprintf(fd_string, MAX_SHM_NAME_LENGTH, "%d", shmid);
+    setenv(RING_BUFFER_FD_ENVIRONMENT, fd_string, 1);
 }
 
 int retrieve_ring_buffer(key_t key) {
-    // size for ring buffer to be retrieved
-    size_t size = sizeof(struct RingBuffer) + (sizeof(struct BufferEntry) + buffer_capacity) * buffer_number;
-    // retrieve existed shared memory segment
-    int shmid = Shmget(key, size, 0);
+    int shmid = -1;
+    if (memory_backend == 0) {
+        // retrieve existed shared memory segment
+        shmid = Shmget(key, ring_buffer_size(), 0);
+    } else if (memory_backend == 1) {
+        // open existed posix shared memory object
+        char name[MAX_SHM_NAME_LENGTH];
+        shm_name(key, name);
+        shmid = Shm_open(name, O_RDWR, 0);
+    } else {
+        // memfd is inherited from simple-cp
+        const char * fd_string = getenv(RING_BUFFER_FD_ENVIRONMENT);
+        if (fd_string == NULL) {
+            printf("%s: memfd for ring buffer not inherited.\n", __progname);
+            exit(-1);
+        }
+        shmid = atoi(fd_string);
+    }
     if (verbose_flag) printf("%s: ring buffer associated with key 0x%x retrieved.\n", __progname, key);
 
     return shmid;
 }
 
 struct RingBuffer * attach_ring_buffer(int shmid) {
-    // attach ring buffer
-    struct RingBuffer * ring_buffer = Shmat(shmid, NULL, SHM_W | SHM_R);
+    struct RingBuffer * ring_buffer = NULL;
+    size_t size = ring_buffer_size();
+    if (memory_backend == 0) {
+        // attach ring buffer
+        ring_buffer = Shmat(shmid, NULL, SHM_W | SHM_R);
+        // prefault page tables since shmat has no populate flag
+        if (populate_flag && madvise(ring_buffer, size, MADV_POPULATE_WRITE) == -1) {
+            if (verbose_flag) printf("%s: failed to prefault ring buffer, %s.\n", __progname, strerror(errno));
+        }
+    } else {
+        // map ring buffer, prefault page tables with MAP_POPULATE if required
+        ring_buffer = Mmap(size, MAP_SHARED | (populate_flag ? MAP_POPULATE : 0), shmid);
+        // posix shared memory lives on tmpfs, ask for transparent huge pages
+        if (memory_backend == 1 && huge_pages_flag && madvise(ring_buffer, size, MADV_HUGEPAGE) == -1) {
+            if (verbose_flag) printf("%s: failed to advise huge pages for ring buffer, %s.\n", __progname, strerror(errno));
+        }
+    }
     if (verbose_flag) printf("%s: attached ring buffer to current address space.\n", __progname);
 
     return ring_buffer;
@@ -100,39 +345,330 @@ struct RingBuffer * attach_ring_buffer(int shmid) {
 
 void deattach_ring_buffer(struct RingBuffer * ring_buffer) {
     // deattach ring buffer
-    Shmdt(ring_buffer);
+    if (memory_backend == 0) Shmdt(ring_buffer);
+    else munmap(ring_buffer, ring_buffer_size());
 }
 
-void produce(struct RingBuffer * ring_buffer, int size, void * buffer) {
-    // version 3 - retry loop
-    if (type == 2) while(ring_buffer->in - ring_buffer->out == buffer_number);
+// out of the consumer furthest behind, slots before it have been released by every consumer
+// a single consumer's out otherwise, loaded with given memory order
+size_t slowest_out(struct RingBuffer * ring_buffer, int order) {
+    size_t out = __atomic_load_n(&ring_buffer->consumer[0].out, order);
+    for (int index = 1 ; index < consumers ; ++index) {
+        size_t other = __atomic_load_n(&ring_buffer->consumer[index].out, order);
+        if (other < out) out = other;
+    }
+    return out;
+}
 
-    // get next in buffer entry
-    struct BufferEntry * entry = (struct BufferEntry *)((char *)(ring_buffer + 1) + (sizeof(struct BufferEntry) + buffer_capacity) * (ring_buffer->in % buffer_number));
-    // copy from temp buffer to shared memory buffer and set size
-    memcpy(entry->bytes, buffer, size);
-    entry->size = size;
-    if (verbose_flag) printf("%s: %d bytes data produced into buffer %d.\n", __progname, size, (ring_buffer->in % buffer_number));
-    // modify in
-    ring_buffer->in = ring_buffer->in + 1;
+struct RingBufferConsumer * current_consumer(struct RingBuffer * ring_buffer) {
+    return &ring_buffer->consumer[consumer_index];
 }
 
-void consume(struct RingBuffer * ring_buffer, int * size, void * buffer) {
-    // version 3 - retry loop
-    if (type == 2) while (ring_buffer->in - ring_buffer->out == 0);
-
-    // get next out buffer entry
-    struct BufferEntry * entry = (struct BufferEntry *)((char *)(ring_buffer + 1) + (sizeof(struct BufferEntry) + buffer_capacity) * (ring_buffer->out % buffer_number));
-    // get size from buffer entry
-    *size = entry->size;
-    // copy from shared memory buffer to temp buffer
-    memcpy(buffer, entry->bytes, *size);
-    entry->size = 0;
-    if (verbose_flag) printf("%s: %d bytes data consumed from buffer %d.\n", __progname, *size, (ring_buffer->out % buffer_number));
+// lock-free spsc, wait until needed more units(slots, or bytes of stream ring) fit after in
+// only reload out(the consumers' lines) when cached snapshot says there's no room
+void spsc_wait_for_space(struct RingBuffer * ring_buffer, size_t in, size_t needed, size_t limit) {
+    int spin = 0;
+    while (in + needed - ring_buffer->cached_out > limit) {
+        // acquire pairs with consumer's release, slot is safe to overwrite afterwards
+        ring_buffer->cached_out = slowest_out(ring_buffer, __ATOMIC_ACQUIRE);
+        if (in + needed - ring_buffer->cached_out <= limit) break;
+        if (++spin < SPIN_LIMIT) cpu_relax();
+        else { spin = 0; sched_yield(); } // give up processor if consumer is not running
+    }
+}
+
+// lock-free spsc, wait until something has been published after out
+// only reload in(the producer's line) when cached snapshot says ring buffer is empty
+void spsc_wait_for_data(struct RingBuffer * ring_buffer, size_t out) {
+    struct RingBufferConsumer * consumer = current_consumer(ring_buffer);
+    int spin = 0;
+    while (consumer->cached_in == out) {
+        // acquire pairs with producer's release, slot content is visible afterwards
+        consumer->cached_in = __atomic_load_n(&ring_buffer->in, __ATOMIC_ACQUIRE);
+        if (consumer->cached_in != out) break;
+        if (++spin < SPIN_LIMIT) cpu_relax();
+        else { spin = 0; sched_yield(); } // give up processor if producer is not running
+    }
+}
+
+// futex wait wrapper, sleep while *word equals value
+// not FUTEX_PRIVATE_FLAG since the word lives in shared memory between processes
+void futex_wait(unsigned int * word, unsigned int value) {
+    if (syscall(SYS_futex, word, FUTEX_WAIT, value, NULL, NULL, 0) == -1 && errno != EAGAIN && errno != EINTR) {
+        printf("futex failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to wait on futex.\n", __progname);
+        exit(-1);
+    }
+}
+
+// futex wake wrapper, wake the only waiter
+void futex_wake(unsigned int * word) {
+    if (syscall(SYS_futex, word, FUTEX_WAKE, 1, NULL, NULL, 0) == -1) {
+        printf("futex failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to wake futex waiter.\n", __progname);
+        exit(-1);
+    }
+}
+
+// spin-then-futex, spin for a bounded time then park on space_event
+void hybrid_wait_for_space(struct RingBuffer * ring_buffer, size_t in, size_t needed, size_t limit) {
+    // spin phase, the consumer usually frees a slot within nanoseconds
+    for (int spin = 0 ; in + needed - ring_buffer->cached_out > limit ; ++spin) {
+        ring_buffer->cached_out = slowest_out(ring_buffer, __ATOMIC_ACQUIRE);
+        if (in + needed - ring_buffer->cached_out <= limit) return;
+        if (spin == SPIN_LIMIT) break;
+        cpu_relax();
+    }
+    // park phase, record waiter before checking out again so that consumer can't miss it
+    while (in + needed - ring_buffer->cached_out > limit) {
+        unsigned int event = __atomic_load_n(&ring_buffer->space_event, __ATOMIC_ACQUIRE);
+        __atomic_store_n(&ring_buffer->producer_waiting, 1, __ATOMIC_SEQ_CST);
+        ring_buffer->cached_out = slowest_out(ring_buffer, __ATOMIC_SEQ_CST);
+        if (in + needed - ring_buffer->cached_out <= limit) break;
+        futex_wait(&ring_buffer->space_event, event);
+    }
+    __atomic_store_n(&ring_buffer->producer_waiting, 0, __ATOMIC_RELAXED);
+}
+
+// spin-then-futex, spin for a bounded time then park on data_event of calling consumer
+void hybrid_wait_for_data(struct RingBuffer * ring_buffer, size_t out) {
+    struct RingBufferConsumer * consumer = current_consumer(ring_buffer);
+    // spin phase, the producer usually fills a slot within nanoseconds
+    for (int spin = 0 ; consumer->cached_in == out ; ++spin) {
+        consumer->cached_in = __atomic_load_n(&ring_buffer->in, __ATOMIC_ACQUIRE);
+        if (consumer->cached_in != out) return;
+        if (spin == SPIN_LIMIT) break;
+        cpu_relax();
+    }
+    // park phase, record waiter before checking in again so that producer can't miss it
+    while (consumer->cached_in == out) {
+        unsigned int event = __atomic_load_n(&consumer->data_event, __ATOMIC_ACQUIRE);
+        __atomic_store_n(&consumer->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+        consumer->cached_in = __atomic_load_n(&ring_buffer->in, __ATOMIC_SEQ_CST);
+        if (consumer->cached_in != out) break;
+        futex_wait(&consumer->data_event, event);
+    }
+    __atomic_store_n(&consumer->consumer_waiting, 0, __ATOMIC_RELAXED);
+}
+
+// spin-then-futex, wake the other side only if it has recorded itself as waiting
+// fence pairs with the waiter's store/load so that either waker sees the waiter
+// or the waiter sees the new index, waiting lives on a park line nobody writes
+// until a side parks, so the load after it stays a hit in the waker's cache
+void hybrid_wake(unsigned int * waiting, unsigned int * event) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(waiting, __ATOMIC_RELAXED)) {
+        __atomic_fetch_add(event, 1, __ATOMIC_RELEASE);
+        futex_wake(event);
+    }
+}
+
+// get buffer entry(slot descriptor) with given in/out index
+struct BufferEntry * get_buffer_entry(struct RingBuffer * ring_buffer, size_t index) {
+    return (struct BufferEntry *)(ring_buffer + 1) + index % buffer_number;
+}
+
+// get slot bytes with given in/out index
+char * get_buffer_bytes(struct RingBuffer * ring_buffer, size_t index) {
+    return (char *)ring_buffer + slot_offset() + slot_stride() * (index % buffer_number);
+}
+
+// get stream ring byte with given in/out index(in bytes)
+char * get_stream_bytes(struct RingBuffer * ring_buffer, size_t index) {
+    return (char *)ring_buffer + slot_offset() + index % stream_size();
+}
+
+void * reserve_write_slot(struct RingBuffer * ring_buffer) {
+    // stats mode, only take timestamps when there's no empty slot so the common path stays cheap
+    // semaphore implementation waits outside ring buffer, its stalls are recorded by caller
+    struct timespec start;
+    int stalled = space_stalled(ring_buffer, ring_buffer->in + ring_buffer->reserved, 1, buffer_number);
+    if (stalled) start_stats_clock(&start);
+
+    // version 3 - retry loop, acquire pairs with consumer's release and keeps the load inside the loop
+    if (type == 2) while (ring_buffer->in + ring_buffer->reserved - slowest_out(ring_buffer, __ATOMIC_ACQUIRE) == buffer_number);
+    // version 4 - lock-free spsc
+    if (type == 3) spsc_wait_for_space(ring_buffer, ring_buffer->in + ring_buffer->reserved, 1, buffer_number);
+    // version 5 - spin-then-futex
+    if (type == 4) hybrid_wait_for_space(ring_buffer, ring_buffer->in + ring_buffer->reserved, 1, buffer_number);
+
+    if (stalled) record_stall(&ring_buffer->producer_stats, &start);
+
+    // return bytes of next empty buffer entry after reserved ones
+    return get_buffer_bytes(ring_buffer, ring_buffer->in + ring_buffer->reserved++);
+}
+
+void commit_write_slot(struct RingBuffer * ring_buffer, int size) {
+    // set size of the oldest reserved buffer entry
+    get_buffer_entry(ring_buffer, ring_buffer->in)->size = size;
+    --ring_buffer->reserved;
+    if (verbose_flag) printf("%s: %d bytes data produced into buffer %zu.\n", __progname, size, (ring_buffer->in % buffer_number));
+    // modify in, release makes entry visible before in
+    __atomic_store_n(&ring_buffer->in, ring_buffer->in + 1, __ATOMIC_RELEASE);
+    // version 5 - spin-then-futex, wake parked consumers
+    if (type == 4) for (int index = 0 ; index < consumers ; ++index) hybrid_wake(&ring_buffer->consumer[index].consumer_waiting, &ring_buffer->consumer[index].data_event);
+    // stats mode, sample occupancy once every interval slots
+    if (stats_flag && ring_buffer->in % STATS_SAMPLE_INTERVAL == 0) sample_occupancy(ring_buffer);
+}
+
+void * peek_read_slot(struct RingBuffer * ring_buffer, int * size) {
+    struct RingBufferConsumer * consumer = current_consumer(ring_buffer);
+    // stats mode, only take timestamps when there's no full slot so the common path stays cheap
+    struct timespec start;
+    int stalled = data_stalled(ring_buffer, consumer->out + consumer->peeked);
+    if (stalled) start_stats_clock(&start);
+
+    // version 3 - retry loop, acquire pairs with producer's release and keeps the load inside the loop
+    if (type == 2) while (__atomic_load_n(&ring_buffer->in, __ATOMIC_ACQUIRE) - consumer->out - consumer->peeked == 0);
+    // version 4 - lock-free spsc
+    if (type == 3) spsc_wait_for_data(ring_buffer, consumer->out + consumer->peeked);
+    // version 5 - spin-then-futex
+    if (type == 4) hybrid_wait_for_data(ring_buffer, consumer->out + consumer->peeked);
+
+    if (stalled) record_stall(&consumer->stats, &start);
+
+    // get size and return bytes of next full buffer entry after peeked ones
+    size_t index = consumer->out + consumer->peeked++;
+    *size = get_buffer_entry(ring_buffer, index)->size;
+    return get_buffer_bytes(ring_buffer, index);
+}
+
+void release_read_slot(struct RingBuffer * ring_buffer) {
+    // entry of the oldest peeked slot is left as it is, other consumers of a tee ring buffer may not have read it
+    struct RingBufferConsumer * consumer = current_consumer(ring_buffer);
+    struct BufferEntry * entry = get_buffer_entry(ring_buffer, consumer->out);
+    --consumer->peeked;
+    if (verbose_flag) printf("%s: %d bytes data consumed from buffer %zu.\n", __progname, entry->size, (consumer->out % buffer_number));
     // update total_size
-    ring_buffer->total_size += *size;
-    // modity out and clean size
-    ring_buffer->out = ring_buffer->out + 1;
+    __atomic_store_n(&consumer->total_size, consumer->total_size + entry->size, __ATOMIC_RELAXED);
+    // modity out, release makes sure entry has been read before it's reused
+    __atomic_store_n(&consumer->out, consumer->out + 1, __ATOMIC_RELEASE);
+    // version 5 - spin-then-futex, wake parked producer
+    if (type == 4) hybrid_wake(&ring_buffer->producer_waiting, &ring_buffer->space_event);
+}
+
+void commit_write_extent(struct RingBuffer * ring_buffer, int size, off_t offset) {
+    // offset is published together with size by the release in commit
+    get_buffer_entry(ring_buffer, ring_buffer->in)->offset = offset;
+    commit_write_slot(ring_buffer, size);
+}
+
+void * peek_read_extent(struct RingBuffer * ring_buffer, int * size, off_t * offset) {
+    void * bytes = peek_read_slot(ring_buffer, size);
+    struct RingBufferConsumer * consumer = current_consumer(ring_buffer);
+    *offset = get_buffer_entry(ring_buffer, consumer->out + consumer->peeked - 1)->offset;
+    return bytes;
+}
+
+int reserve_stream_record(struct RingBuffer * ring_buffer, struct iovec pieces[2]) {
+    // wait for room of a whole record of buffer capacity, a short read then only takes what it needs
+    size_t size = stream_size();
+    size_t needed = STREAM_HEADER_SIZE + STREAM_ALIGN(buffer_capacity);
+    struct timespec start;
+    int stalled = space_stalled(ring_buffer, ring_buffer->in, needed, size);
+    if (stalled) start_stats_clock(&start);
+
+    // version 3 - retry loop, acquire pairs with consumers' release
+    if (type == 2) while (ring_buffer->in + needed - slowest_out(ring_buffer, __ATOMIC_ACQUIRE) > size);
+    // version 4 - lock-free spsc
+    if (type == 3) spsc_wait_for_space(ring_buffer, ring_buffer->in, needed, size);
+    // version 5 - spin-then-futex
+    if (type == 4) hybrid_wait_for_space(ring_buffer, ring_buffer->in, needed, size);
+    // semaphore implementation has acquired a slot, i.e. room for a whole record
+
+    if (stalled) record_stall(&ring_buffer->producer_stats, &start);
+
+    // record bytes start right after its header, split in two pieces if they wrap around the end
+    size_t offset = (ring_buffer->in + STREAM_HEADER_SIZE) % size;
+    char * bytes = get_stream_bytes(ring_buffer, 0);
+    pieces[0].iov_base = bytes + offset;
+    if (offset + buffer_capacity <= size) {
+        pieces[0].iov_len = buffer_capacity;
+        return 1;
+    }
+    pieces[0].iov_len = size - offset;
+    pieces[1].iov_base = bytes;
+    pieces[1].iov_len = buffer_capacity - (size - offset);
+    return 2;
+}
+
+void commit_stream_record(struct RingBuffer * ring_buffer, int size) {
+    // header is never split, records and stream ring are both aligned to header size
+    *(int *)get_stream_bytes(ring_buffer, ring_buffer->in) = size;
+    if (verbose_flag) printf("%s: %d bytes data produced into stream record at %zu.\n", __progname, size, ring_buffer->in % stream_size());
+    // modify in, release makes record visible before in
+    __atomic_store_n(&ring_buffer->in, ring_buffer->in + STREAM_HEADER_SIZE + STREAM_ALIGN(size), __ATOMIC_RELEASE);
+    // version 5 - spin-then-futex, wake parked consumers
+    if (type == 4) for (int index = 0 ; index < consumers ; ++index) hybrid_wake(&ring_buffer->consumer[index].consumer_waiting, &ring_buffer->consumer[index].data_event);
+}
+
+int peek_stream_records(struct RingBuffer * ring_buffer, struct iovec * pieces, int max_records, int * records, int * end_of_file) {
+    struct RingBufferConsumer * consumer = current_consumer(ring_buffer);
+    struct timespec start;
+    int stalled = data_stalled(ring_buffer, consumer->out);
+    if (stalled) start_stats_clock(&start);
+
+    // version 3 - retry loop, acquire pairs with producer's release
+    if (type == 2) while (__atomic_load_n(&ring_buffer->in, __ATOMIC_ACQUIRE) == consumer->out);
+    // version 4 - lock-free spsc
+    if (type == 3) spsc_wait_for_data(ring_buffer, consumer->out);
+    // version 5 - spin-then-futex
+    if (type == 4) hybrid_wait_for_data(ring_buffer, consumer->out);
+
+    if (stalled) record_stall(&consumer->stats, &start);
+
+    // walk records published so far, stop at the empty record(end of file)
+    size_t size = stream_size();
+    size_t in = __atomic_load_n(&ring_buffer->in, __ATOMIC_ACQUIRE);
+    size_t index = consumer->out;
+    char * bytes = get_stream_bytes(ring_buffer, 0);
+    int count = 0;
+    *records = *end_of_file = 0;
+    while (index != in && *records < max_records) {
+        int length = *(int *)get_stream_bytes(ring_buffer, index);
+        size_t offset = (index + STREAM_HEADER_SIZE) % size;
+        index += STREAM_HEADER_SIZE + STREAM_ALIGN(length);
+        ++*records;
+        if (length == 0) {
+            *end_of_file = 1;
+            break;
+        }
+        // record wrapping around the end takes two pieces
+        size_t first = offset + length <= size ? length : size - offset;
+        pieces[count].iov_base = bytes + offset;
+        pieces[count++].iov_len = first;
+        if (first < length) {
+            pieces[count].iov_base = bytes;
+            pieces[count++].iov_len = length - first;
+        }
+    }
+    consumer->peeked = index - consumer->out;
+    return count;
+}
+
+void release_stream_records(struct RingBuffer * ring_buffer, size_t size) {
+    struct RingBufferConsumer * consumer = current_consumer(ring_buffer);
+    if (verbose_flag) printf("%s: %zu bytes data consumed from stream ring.\n", __progname, size);
+    // update total_size
+    __atomic_store_n(&consumer->total_size, consumer->total_size + size, __ATOMIC_RELAXED);
+    // modity out, release makes sure records have been read before they're reused
+    __atomic_store_n(&consumer->out, consumer->out + consumer->peeked, __ATOMIC_RELEASE);
+    consumer->peeked = 0;
+    // version 5 - spin-then-futex, wake parked producer
+    if (type == 4) hybrid_wake(&ring_buffer->producer_waiting, &ring_buffer->space_event);
+}
+
+void produce(struct RingBuffer * ring_buffer, int size, void * buffer) {
+    // copy from temp buffer to shared memory buffer and publish it
+    memcpy(reserve_write_slot(ring_buffer), buffer, size);
+    commit_write_slot(ring_buffer, size);
+}
+
+void consume(struct RingBuffer * ring_buffer, int * size, void * buffer) {
+    // copy from shared memory buffer to temp buffer and give it back, size is only known after peek
+    void * bytes = peek_read_slot(ring_buffer, size);
+    memcpy(buffer, bytes, *size);
+    release_read_slot(ring_buffer);
 }
 
 void delete_ring_buffer(int shmid) {
@@ -142,11 +678,148 @@ void delete_ring_buffer(int shmid) {
     //     exit(-1);
     // }
     // unnecessary to add printf for cleanup function
-    shmctl(shmid, IPC_RMID, NULL);
+    if (memory_backend == 0) {
+        shmctl(shmid, IPC_RMID, NULL);
+    } else {
+        if (memory_backend == 1) {
+            char name[MAX_SHM_NAME_LENGTH];
+            shm_name(ipc_key, name);
+            shm_unlink(name);
+        }
+        if (shmid != -1) close(shmid);
+    }
+}
+
+size_t number_of_empty_slots(struct RingBuffer * ring_buffer) {
+    // called by producer, slots neither full nor reserved
+    return buffer_number - (ring_buffer->in + ring_buffer->reserved - slowest_out(ring_buffer, __ATOMIC_ACQUIRE));
+}
+
+size_t number_of_full_slots(struct RingBuffer * ring_buffer) {
+    // called by consumer, slots committed but not peeked
+    struct RingBufferConsumer * consumer = current_consumer(ring_buffer);
+    return __atomic_load_n(&ring_buffer->in, __ATOMIC_ACQUIRE) - consumer->out - consumer->peeked;
 }
 
 size_t number_of_bytes_transferred(struct RingBuffer * ring_buffer) {
-    // return the number of bytes transferred(total_size)
-    return ring_buffer->total_size; 
+    // return the number of bytes transferred(total_size), a tee copy is as far as its slowest dest
+    size_t total_size = __atomic_load_n(&ring_buffer->consumer[0].total_size, __ATOMIC_RELAXED);
+    for (int index = 1 ; index < consumers ; ++index) {
+        size_t other = __atomic_load_n(&ring_buffer->consumer[index].total_size, __ATOMIC_RELAXED);
+        if (other < total_size) total_size = other;
+    }
+    return total_size;
+}
+
+void skip_bytes(struct RingBuffer * ring_buffer, size_t size) {
+    struct RingBufferConsumer * consumer = current_consumer(ring_buffer);
+    __atomic_store_n(&consumer->skipped_size, consumer->skipped_size + size, __ATOMIC_RELAXED);
+}
+
+size_t number_of_bytes_skipped(struct RingBuffer * ring_buffer) {
+    // every dest of a tee copy skips the same holes
+    size_t skipped_size = __atomic_load_n(&ring_buffer->consumer[0].skipped_size, __ATOMIC_RELAXED);
+    for (int index = 1 ; index < consumers ; ++index) {
+        size_t other = __atomic_load_n(&ring_buffer->consumer[index].skipped_size, __ATOMIC_RELAXED);
+        if (other < skipped_size) skipped_size = other;
+    }
+    return skipped_size;
+}
+
+// stats mode, test if producer is about to wait for needed more units after in
+// the locally cached out is enough unless it says there's no room, only then are the consumers'
+// lines read, so that stats don't add traffic on them(retry loop keeps cached_out for it alone)
+int space_stalled(struct RingBuffer * ring_buffer, size_t in, size_t needed, size_t limit) {
+    if (!stats_flag || type < 2 || type > 4) return 0;
+    if (in + needed - ring_buffer->cached_out <= limit) return 0;
+    ring_buffer->cached_out = slowest_out(ring_buffer, __ATOMIC_ACQUIRE);
+    return in + needed - ring_buffer->cached_out > limit;
+}
+
+// stats mode, test if consumer is about to wait for something published after out
+// same as space_stalled, in is only read when the locally cached one has been caught up with
+int data_stalled(struct RingBuffer * ring_buffer, size_t out) {
+    struct RingBufferConsumer * consumer = current_consumer(ring_buffer);
+    if (!stats_flag || type < 2 || type > 4) return 0;
+    if (consumer->cached_in > out) return 0;
+    consumer->cached_in = __atomic_load_n(&ring_buffer->in, __ATOMIC_ACQUIRE);
+    return consumer->cached_in == out;
 }
 
+void start_stats_clock(struct timespec * start) {
+    clock_gettime(CLOCK_MONOTONIC, start);
+}
+
+// nanoseconds passed since start
+size_t elapsed_nanoseconds(struct timespec * start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1000000000L + (end.tv_nsec - start->tv_nsec);
+}
+
+void record_stall(struct RingBufferStats * stats, struct timespec * start) {
+    // stats are only written by their own side and read after put/get processes exit, no atomics needed
+    size_t nanoseconds = elapsed_nanoseconds(start);
+    ++stats->stalls;
+    stats->stall_nanoseconds += nanoseconds;
+    if (nanoseconds > stats->max_stall_nanoseconds) stats->max_stall_nanoseconds = nanoseconds;
+}
+
+void record_latency(struct RingBufferStats * stats, struct timespec * start) {
+    // log2 bucket of latency in micro seconds
+    size_t microseconds = elapsed_nanoseconds(start) / 1000;
+    int bucket = 0;
+    while (microseconds && bucket < STATS_HISTOGRAM_BUCKETS - 1) {
+        microseconds >>= 1;
+        ++bucket;
+    }
+    ++stats->latency_histogram[bucket];
+}
+
+// called by producer, full slots right after a commit
+void sample_occupancy(struct RingBuffer * ring_buffer) {
+    struct RingBufferStats * stats = &ring_buffer->producer_stats;
+    size_t full = ring_buffer->in - slowest_out(ring_buffer, __ATOMIC_ACQUIRE);
+    ++stats->occupancy_samples;
+    stats->occupancy_total += full;
+    if (full == buffer_number) ++stats->full_samples;
+}
+
+// print non-empty buckets of latency histogram
+void print_latency_histogram(const char * name, struct RingBufferStats * stats) {
+    printf("%s latency(micro seconds):\n", name);
+    for (int bucket = 0 ; bucket < STATS_HISTOGRAM_BUCKETS ; ++bucket) {
+        if (stats->latency_histogram[bucket] == 0) continue;
+        size_t low = bucket ? 1UL << (bucket - 1) : 0;
+        if (bucket == STATS_HISTOGRAM_BUCKETS - 1) printf("    [%zu, inf)\t%zu\n", low, stats->latency_histogram[bucket]);
+        else printf("    [%zu, %zu)\t%zu\n", low, 1UL << bucket, stats->latency_histogram[bucket]);
+    }
+}
+
+void print_ring_buffer_stats(struct RingBuffer * ring_buffer, int job) {
+    struct RingBufferStats * producer = &ring_buffer->producer_stats;
+    printf("ring buffer %d statistics:\n", job);
+    printf("producer stalled %zu times waiting for empty slot, %.6f seconds in total, %.6f seconds at most\n",
+           producer->stalls, producer->stall_nanoseconds / 1000000000.0, producer->max_stall_nanoseconds / 1000000000.0);
+    for (int index = 0 ; index < consumers ; ++index) {
+        struct RingBufferStats * consumer = &ring_buffer->consumer[index].stats;
+        if (consumers > 1) printf("consumer %d ", index);
+        else printf("consumer ");
+        printf("stalled %zu times waiting for full slot, %.6f seconds in total, %.6f seconds at most\n",
+               consumer->stalls, consumer->stall_nanoseconds / 1000000000.0, consumer->max_stall_nanoseconds / 1000000000.0);
+    }
+    if (producer->occupancy_samples) {
+        printf("occupancy %.2f of %d slots on average, full in %.1f%% of %zu samples\n",
+               (double)producer->occupancy_total / producer->occupancy_samples, buffer_number,
+               100.0 * producer->full_samples / producer->occupancy_samples, producer->occupancy_samples);
+    } else {
+        printf("occupancy not sampled, stream mode or less than %d slots transferred\n", STATS_SAMPLE_INTERVAL);
+    }
+    print_latency_histogram("read", producer);
+    for (int index = 0 ; index < consumers ; ++index) {
+        char name[MAX_STATS_NAME_LENGTH];
+        if (consumers > 1) snprintf(name, sizeof(name), "write of consumer %d", index);
+        else snprintf(name, sizeof(name), "write");
+        print_latency_histogram(name, &ring_buffer->consumer[index].stats);
+    }
+}
@@ -2,46 +2,179 @@
 #define RING_BUFFER_H
 
 #include <sys/types.h> // contains definition for key_t
+#include <time.h> // contains definition for struct timespec
+#include <sys/uio.h> // contains definition for struct iovec
+
+#define CACHE_LINE_SIZE 64 // cache line size used to separate producer/consumer state
+#define STATS_HISTOGRAM_BUCKETS 20 // bucket 0 counts latency below 1 micro second, bucket i below 2^i, last one the rest
+#define STATS_SAMPLE_INTERVAL 64 // occupancy is sampled once every interval slots
+#define STREAM_HEADER_SIZE 8 // length prefix of a stream record, records are aligned to it
+#define STREAM_ALIGN(size) (((size) + STREAM_HEADER_SIZE - 1) / STREAM_HEADER_SIZE * STREAM_HEADER_SIZE)
+#define MAX_CONSUMERS 8 // max consumers of a tee ring buffer, one for each dest file
+#define PRODUCER -1 // consumer index of producer, its semaphore operations go to all consumers
 
 // shared memory generally structs below:
 //
-//  <--------RingBuffer-------> <-------BufferEntry0-------> <-------
-// +--------+---------+--------+--------+-------------------+--------+--
-// |   in   |   out   |  size  |  size  |       bytes       |  size  |...
-// +--------+---------+--------+--------+-------------------+--------+--
+//  <-----------------RingBuffer-----------------> <--BufferEntry--->      <-----slot 0-----> <--
+// +---------------------+-----------------------+--------+--------+-----+-------------------+--
+// | in | cached_out ... | out | cached_in | ... |  size  |  size  | pad |       bytes       |...
+// +---------------------+-----------------------+--------+--------+-----+-------------------+--
+//  <---producer line---> <---consumer line-----> (+ park lines, digest line, stats, consumers 1...)
+//                                                                      ^ slot 0 aligned to slot alignment
+//
+// RingBuffer contains two BufferEntry indexes in/out, each one on its own cache line
+// so that producer and consumer won't keep stealing the same line from each other
+// in/out increase monotonically, slot index is in/out % buffer_number
+// reserved/peeked count slots handed out by reserve/peek but not yet committed/released
+// total_size counts bytes consumed, it lives on its own line so that polling it for progress
+// never touches the lines producer and consumer synchronize on, so does skipped_size which
+// counts bytes of holes consumer has skipped in sparse copy
+// cached_in/cached_out are private snapshots of the other side's index(lock-free spsc/futex only)
+// data_event/space_event are futex words bumped by producer/consumer to wake the other side,
+// producer_waiting/consumer_waiting are set while parked on them(spin-then-futex only), they live
+// on park lines apart from in/out so that the waker's check on each commit/release is a read of
+// a line nobody writes until a side actually parks
+// source_digest/dest_digest are crc32c of bytes put/got, computed by each side on its own while
+// slot bytes are still in cache right after read/before write, source_size counts bytes put
+// producer_stats/consumer stats are only written by their own side in stats mode, each on its own lines,
+// a stall is a wait for a slot that wasn't available when asked for
+//
+// everything a consumer writes lives in its RingBufferConsumer, a tee ring buffer has one of them
+// for each dest file and a single in shared by all, so that N copies cost one read of source
+// each consumer only moves its own out, producer waits for the slowest one(smallest out) before
+// reusing a slot, and wakes each parked consumer on its own data_event
+// BufferEntry is the descriptor of a slot, size indicates actual bytes stored in it and offset
+// where they belong in file, so that a slot describes an extent and holes between extents are never sent
+// descriptors are kept apart from slot bytes so that every slot starts on an aligned address,
+// slot alignment is a cache line, or a page in direct io mode so that slots can be used with O_DIRECT
+//
+// in stream mode slots are replaced by one contiguous ring of bytes, in/out count bytes instead of slots
 //
-// RingBuffer contains two BufferEntry pointers in/out
-// BufferEntry contains size and bytes, where size indicates actual bytes stored in buffer
-// bytes is stored data, implemented with 0 length array
+//  <-----------------RingBuffer----------------->      <--record--> <-------record-------> <-free->
+// +---------------------+-----------------------+-----+------+-----+------+--------------+--------+
+// | in | cached_out ... | out | cached_in | ... | ... | size |bytes| size |    bytes     |        |
+// +---------------------+-----------------------+-----+------+-----+------+--------------+--------+
+//
+// a record is a length prefix followed by bytes of one read, padded to the prefix size,
+// so a short read only takes what it needs, bytes of a record may wrap around the end of ring
+// a record of size 0 marks end of file
+
+// statistics of one side of ring buffer
+struct RingBufferStats {
+    size_t stalls; // times no slot was available
+    size_t stall_nanoseconds; // total time spent waiting for a slot
+    size_t max_stall_nanoseconds; // longest wait for a slot
+    size_t occupancy_samples; // occupancy samples taken(producer only)
+    size_t occupancy_total; // sum of full slots over all samples(producer only)
+    size_t full_samples; // samples taken when all slots were full(producer only)
+    size_t latency_histogram[STATS_HISTOGRAM_BUCKETS]; // read(producer)/write(consumer) latency of each slot
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+// one consumer of ring buffer, all but the first are only used in tee mode
+struct RingBufferConsumer {
+    // consumer line, only written by this consumer
+    size_t out __attribute__((aligned(CACHE_LINE_SIZE)));
+    size_t cached_in;
+    size_t peeked;
+    // park line, written by this consumer when it parks and by producer waking it
+    unsigned int data_event __attribute__((aligned(CACHE_LINE_SIZE)));
+    unsigned int consumer_waiting;
+    // progress line, only written by this consumer and polled by progress bar
+    size_t total_size __attribute__((aligned(CACHE_LINE_SIZE)));
+    size_t skipped_size;
+    unsigned int dest_digest; // written once at the end in verify mode
+    // statistics of this consumer
+    struct RingBufferStats stats;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
 
 // struct RingBuffer and struct BufferEntry should be private actually
 // TO BE FIXED
 // ring buffer definition
 struct RingBuffer {
-    int in;
-    int out;
-    size_t total_size;
-};
+    // producer line, only written by producer
+    size_t in __attribute__((aligned(CACHE_LINE_SIZE)));
+    size_t cached_out;
+    size_t reserved;
+    // park line, written by producer when it parks and by consumers waking it
+    unsigned int space_event __attribute__((aligned(CACHE_LINE_SIZE)));
+    unsigned int producer_waiting;
+    // digest line, written once by producer at the end in verify mode
+    size_t source_size __attribute__((aligned(CACHE_LINE_SIZE)));
+    unsigned int source_digest;
+    // statistics of producer
+    struct RingBufferStats producer_stats;
+    // consumer lines, first one is the only consumer unless in tee mode
+    struct RingBufferConsumer consumer[MAX_CONSUMERS];
+} __attribute__((aligned(CACHE_LINE_SIZE)));
 
 struct BufferEntry {
     int size;
-    char bytes[0];
+    off_t offset;
 };
 
 // create/retrieve/delete
 int create_ring_buffer(void);
 int retrieve_ring_buffer(key_t key);
 void delete_ring_buffer(int shmid);
+void export_ring_buffer(int shmid);
+
+// create/delete in-process ring buffer shared by threads
+struct RingBuffer * create_private_ring_buffer(void);
+void delete_private_ring_buffer(struct RingBuffer * ring_buffer);
 
 // attach and deattach
 struct RingBuffer * attach_ring_buffer(int shmid);
 void deattach_ring_buffer(struct RingBuffer * ring_buffer);
 
-// produce and consume
+// produce and consume(copy in/out of a temp buffer)
 void produce(struct RingBuffer * ring_buffer, int size, void * buffer);
 void consume(struct RingBuffer * ring_buffer, int * size, void * buffer);
 
-// get the number of bytes transferred
+// zero-copy slot access, read/write straight into shared memory
+// reserve returns bytes of next empty slot, commit publishes it with given size
+// peek returns bytes(and size) of next full slot, release gives it back to producer
+// several slots may be reserved/peeked at once, they are committed/released in order
+void * reserve_write_slot(struct RingBuffer * ring_buffer);
+void commit_write_slot(struct RingBuffer * ring_buffer, int size);
+void * peek_read_slot(struct RingBuffer * ring_buffer, int * size);
+void release_read_slot(struct RingBuffer * ring_buffer);
+// same as commit/peek, file offset of slot bytes travels in its descriptor next to size
+void commit_write_extent(struct RingBuffer * ring_buffer, int size, off_t offset);
+void * peek_read_extent(struct RingBuffer * ring_buffer, int * size, off_t * offset);
+
+// stream ring, records are committed/released in order
+// reserve returns one or two(wrapping) pieces of room for a record of up to buffer capacity bytes,
+// commit publishes it with given size
+// peek returns bytes of up to max_records published records as pieces(2 * max_records at most),
+// records is set to the number of records peeked and end_of_file if the empty record is among them,
+// release gives all of them back to producer, size is the number of bytes they carried
+int reserve_stream_record(struct RingBuffer * ring_buffer, struct iovec pieces[2]);
+void commit_stream_record(struct RingBuffer * ring_buffer, int size);
+int peek_stream_records(struct RingBuffer * ring_buffer, struct iovec * pieces, int max_records, int * records, int * end_of_file);
+void release_stream_records(struct RingBuffer * ring_buffer, size_t size);
+
+// get consumer lines of calling process(consumer_index), consumer only
+struct RingBufferConsumer * current_consumer(struct RingBuffer * ring_buffer);
+
+// get alignment of slot bytes
+size_t slot_alignment(void);
+
+// get the number of slots that can be reserved/peeked without waiting
+size_t number_of_empty_slots(struct RingBuffer * ring_buffer);
+size_t number_of_full_slots(struct RingBuffer * ring_buffer);
+
+// get the number of bytes transferred, by the slowest consumer in tee mode
 size_t number_of_bytes_transferred(struct RingBuffer * ring_buffer);
+// count(consumer only) and get the number of bytes of holes skipped in sparse copy
+void skip_bytes(struct RingBuffer * ring_buffer, size_t size);
+size_t number_of_bytes_skipped(struct RingBuffer * ring_buffer);
+
+// statistics, nothing is recorded unless stats mode is on
+// stalls inside reserve/peek are recorded by ring buffer itself, waits outside(semaphore) and
+// read/write latency are recorded by callers with a clock started by start_stats_clock
+void start_stats_clock(struct timespec * start);
+void record_stall(struct RingBufferStats * stats, struct timespec * start);
+void record_latency(struct RingBufferStats * stats, struct timespec * start);
+void print_ring_buffer_stats(struct RingBuffer * ring_buffer, int job);
 
 #endif
@@ -7,6 +7,9 @@
 #include <sys/sem.h>
 #include <sys/stat.h>
 
+// include user headers
+#include "ring-buffer.h"
+
 // include own header
 #include "semaphore.h"
 
@@ -14,9 +17,14 @@ extern const char * __progname; // gcc defined as substitute for argv[0]
 
 extern int verbose_flag; // verbose flag
 extern key_t ipc_key; // IPC key
+extern int consumers; // consumers of each ring buffer, more than one in tee mode
+extern int consumer_index; // consumer of calling process, PRODUCER for producer
 
 // private function list
 int Semget(key_t key, int nsems, int semflg);
+int Semop(int semid, struct sembuf * sops, int nsops);
+int semaphore_count(void);
+int semaphore_operations(int index, int value, struct sembuf * ops);
 
 // semget wrapper
 int Semget(key_t key, int nsems, int semflg) {
@@ -28,11 +36,44 @@ int Semget(key_t key, int nsems, int semflg) {
     return semid;
 }
 
+// semop wrapper, retries when interrupted
+// io_uring teardown in one thread may interrupt semop waiting in another thread of the same process
+int Semop(int semid, struct sembuf * sops, int nsops) {
+    int result = -1;
+    while ((result = semop(semid, sops, nsops)) == -1 && errno == EINTR);
+    return result;
+}
+
+// semaphores of a set, mutex lock followed by full/empty slots of each consumer
+int semaphore_count(void) {
+    return 1 + 2 * consumers;
+}
+
+// fill operations adding value to semaphore index, returns the number of operations
+// a tee ring buffer counts full/empty slots for each consumer, so producer operates on those of all
+// consumers at once(semop applies all or none, P on empty slots waits for the slowest consumer)
+// and a consumer only on its own
+int semaphore_operations(int index, int value, struct sembuf * ops) {
+    int first = consumer_index, last = consumer_index;
+    if (consumer_index == PRODUCER) {
+        first = 0;
+        last = consumers - 1;
+    }
+    if (index == MUTEX_LOCK) first = last = 0;
+    int count = 0;
+    for (int consumer = first ; consumer <= last ; ++consumer) {
+        ops[count].sem_num = index == MUTEX_LOCK ? index : index + 2 * consumer;
+        ops[count].sem_op = value;
+        ops[count++].sem_flg = 0;
+    }
+    return count;
+}
+
 int create_semaphore_set(int slots) {
     int semid = -1;
-    // use semget to create semaphore set with 3 semaphores
-    // 0 - mutex lock, 1 - full slots, 2 - empty slots
-    if ((semid = semget(ipc_key, 3, IPC_CREAT | IPC_EXCL | S_IRUSR | S_IWUSR)) == -1) {
+    // use semget to create semaphore set with 3 semaphores, 2 more for each other consumer in tee mode
+    // 0 - mutex lock, 1 - full slots, 2 - empty slots, 3 - full slots of consumer 1...
+    if ((semid = semget(ipc_key, semaphore_count(), IPC_CREAT | IPC_EXCL | S_IRUSR | S_IWUSR)) == -1) {
         printf("semget failed: %s.\n", strerror(errno));
         if (verbose_flag) printf("%s: failed to create semaphore set.\n", __progname);
         exit(-1);
@@ -40,7 +81,11 @@ int create_semaphore_set(int slots) {
     if (verbose_flag) printf("%s: semaphore set(2) created with id 0x%x.\n", __progname, semid);
 
     // use semctl to set value
-    unsigned short values[3] = {1, 0, slots};
+    unsigned short values[1 + 2 * MAX_CONSUMERS] = {1};
+    for (int consumer = 0 ; consumer < consumers ; ++consumer) {
+        values[FULL_SLOTS + 2 * consumer] = 0;
+        values[EMPTY_SLOTS + 2 * consumer] = slots;
+    }
     union semun sem_val = {.array = values};
     if (semctl(semid, 0, SETALL, sem_val) == -1) {
         printf("semctl failed: %s.\n", strerror(errno));
@@ -48,6 +93,7 @@ int create_semaphore_set(int slots) {
         exit(-1);
     }
     if (verbose_flag) printf("%s: set 1 to semaphore 0(mutex), set 0 to semaphore 1(full slots), set %d to semaphore 2(empty slots).\n", __progname, slots);
+    if (verbose_flag && consumers > 1) printf("%s: so are semaphores 3 to %d for %d more consumers.\n", __progname, semaphore_count() - 1, consumers - 1);
 
     return semid;
 }
@@ -55,7 +101,7 @@ int create_semaphore_set(int slots) {
 int retrieve_semaphore_set(key_t key) {
     int semid = -1;
     // use semget to retrieve semaphore set
-    if ((semid = semget(key, 3, 0)) == -1) {
+    if ((semid = semget(key, semaphore_count(), 0)) == -1) {
         printf("semget failed: %s.\n", strerror(errno));
         if (verbose_flag) printf("%s: failed to retrieve semaphore set givn key 0x%x\n", __progname, key);
         exit(-1);
@@ -66,12 +112,9 @@ int retrieve_semaphore_set(key_t key) {
 }
 
 void semaphore_p(int semid, int index) {
-    struct sembuf ops = {
-        .sem_num = index,
-        .sem_op = -1, // minus 1 for each P operation
-        .sem_flg = 0
-    };
-    if (semop(semid, &ops, 1) == -1) {
+    struct sembuf ops[MAX_CONSUMERS];
+    int count = semaphore_operations(index, -1, ops); // minus 1 for each P operation
+    if (Semop(semid, ops, count) == -1) {
         printf("semop failed: %s.\n", strerror(errno));
         if (verbose_flag) printf("%s: failed to operate P on semaphore %d.\n", __progname, index);
         exit(-1);
@@ -79,18 +122,56 @@ void semaphore_p(int semid, int index) {
 }
 
 void semaphore_v(int semid, int index) {
-    struct sembuf ops = {
-        .sem_num = index,
-        .sem_op = 1, // add 1 for each V operation
-        .sem_flg = 0
-    };
-    if (semop(semid, &ops, 1) == -1) {
+    struct sembuf ops[MAX_CONSUMERS];
+    int count = semaphore_operations(index, 1, ops); // add 1 for each V operation
+    if (Semop(semid, ops, count) == -1) {
         printf("semop failed: %s.\n", strerror(errno));
         if (verbose_flag) printf("%s: failed to operate V on semaphore %d.\n", __progname, index);
         exit(-1);
     }
 }
 
+// acquire up to batch slots, block only if none is available
+// returns the number of slots acquired(at least 1)
+// a whole batch takes one non-blocking semop, fewer available slots step the count down by half
+// until one fits, and a blocking P of 1 waits only when there's none at all
+// producer of a tee ring buffer takes slots from all consumers in each semop(all or none)
+int semaphore_p_batch(int semid, int index, int batch) {
+    struct sembuf ops[MAX_CONSUMERS];
+    int count = semaphore_operations(index, 0, ops);
+    int slots = batch;
+    for ( ; slots > 1 ; slots /= 2) {
+        for (int op = 0 ; op < count ; ++op) {
+            ops[op].sem_op = -slots; // minus slots for batched P operation
+            ops[op].sem_flg = IPC_NOWAIT;
+        }
+        if (Semop(semid, ops, count) == 0) return slots;
+        if (errno != EAGAIN) break;
+    }
+    if (slots == 1) {
+        for (int op = 0 ; op < count ; ++op) {
+            ops[op].sem_op = -1;
+            ops[op].sem_flg = 0;
+        }
+        if (Semop(semid, ops, count) == 0) return 1;
+    }
+    printf("semop failed: %s.\n", strerror(errno));
+    if (verbose_flag) printf("%s: failed to operate P(%d) on semaphore %d.\n", __progname, slots, index);
+    exit(-1);
+}
+
+// release count slots with one semop
+void semaphore_v_batch(int semid, int index, int count) {
+    if (count == 0) return;
+    struct sembuf ops[MAX_CONSUMERS];
+    int operations = semaphore_operations(index, count, ops); // add count for batched V operation
+    if (Semop(semid, ops, operations) == -1) {
+        printf("semop failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to operate V(%d) on semaphore %d.\n", __progname, count, index);
+        exit(-1);
+    }
+}
+
 void remove_semaphore_set(int semid) {
     union semun sem_val;
     // if (semctl(semid, 0, IPC_RMID, sem_val) == -1) {
@@ -4,8 +4,8 @@
 #include <sys/types.h>
 
 #define MUTEX_LOCK 0
-#define FULL_SLOTS 1
-#define EMPTY_SLOTS 2
+#define FULL_SLOTS 1 // consumer i of a tee ring buffer has its own at FULL_SLOTS + 2 * i
+#define EMPTY_SLOTS 2 // so does it at EMPTY_SLOTS + 2 * i
 
 union semun {
     int val;
@@ -17,6 +17,8 @@ int create_semaphore_set(int slots);
 int retrieve_semaphore_set(key_t key);
 void semaphore_p(int semid, int index);
 void semaphore_v(int semid, int index);
+int semaphore_p_batch(int semid, int index, int batch);
+void semaphore_v_batch(int semid, int index, int count);
 void remove_semaphore_set(int semid);
 
 #endif
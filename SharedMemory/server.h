@@ -0,0 +1,18 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+// protocol between simple-cp-server and simple-cp --server over a unix stream socket
+//
+// a client submits one copy per connection: absolute source path and absolute dest path,
+// each terminated by '\0', then it only reads lines written back by server:
+//
+//  progress <bytes done> <bytes total>     after each chunk of the copy is written
+//  done <bytes> <seconds>                  copy finished, server closes connection
+//  error <message>                         copy refused, server closes connection
+//
+// dest is truncated and sized before the first chunk is scheduled
+
+#define MAX_REQUEST_LENGTH 8192 // source and dest paths with their terminators
+#define MAX_MESSAGE_LENGTH 512 // one line from server
+
+#endif
@@ -0,0 +1,336 @@
+// include system headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <time.h>
+
+// const definition
+#define DEFAULT_SIZES "64K,1M,16M" // default test file sizes
+#define DEFAULT_TYPES "1,2,3,4" // default types
+#define DEFAULT_CAPACITIES "4096,65536" // default buffer capacities
+#define DEFAULT_NUMBERS "8,64" // default buffer numbers
+#define DEFAULT_REPEAT 5 // default runs for each configuration
+#define DEFAULT_DIRECTORY "/tmp" // default directory for test files
+
+#define MAX_LIST_LENGTH 16 // max values in one sweep list
+#define MAX_REPEAT 1000 // max runs for each configuration
+#define MAX_PATH_LENGTH 4096 // max path length of test files
+#define MAX_INT_ARGUMENT_LENGTH 12 // max integer arument length
+#define GENERATE_BLOCK_SIZE (1024 * 1024) // bytes written at once when generating test files
+
+// global variables
+extern const char  * __progname; // gcc defined as substitute for argv[0]
+
+int verbose_flag = 0; // verbose flag
+
+int cold_flag = 0; // also run with page cache dropped
+int repeat = DEFAULT_REPEAT; // runs for each configuration
+const char * directory = DEFAULT_DIRECTORY; // directory for test files
+const char * output_file = NULL; // csv file, stdout if not given
+
+off_t sizes[MAX_LIST_LENGTH]; // test file sizes
+int types[MAX_LIST_LENGTH]; // types(-t)
+int capacities[MAX_LIST_LENGTH]; // buffer capacities(--buffer-capacity)
+int numbers[MAX_LIST_LENGTH]; // buffer numbers(--buffer-number)
+int size_count, type_count, capacity_count, number_count; // length of lists above
+
+// result of one run
+struct Run {
+    double seconds; // wall clock time
+    double user_seconds; // user cpu time of simple-cp and its put/get processes
+    double system_seconds; // system cpu time of simple-cp and its put/get processes
+    long voluntary_switches; // voluntary context switches(blocked on semaphore, futex, io...)
+    long involuntary_switches; // involuntary context switches(preempted)
+};
+
+// function list
+off_t parse_size(const char * text);
+int parse_list(const char * text, int * values);
+int parse_size_list(const char * text, off_t * values);
+
+void help(int exit_number);
+
+void generate(const char * file, off_t size);
+void drop_cache(const char * file);
+int run(const char * source, const char * dest, int type, int capacity, int number, struct Run * result);
+int compare_seconds(const void * a, const void * b);
+void benchmark(FILE * output, const char * source, off_t size, int cold, int type, int capacity, int number);
+
+// convert size with optional K/M/G suffix to bytes
+off_t parse_size(const char * text) {
+    char * end = NULL;
+    off_t size = strtoll(text, &end, 10);
+    switch (*end) {
+        case 'K':   size <<= 10;    ++end;  break;
+        case 'M':   size <<= 20;    ++end;  break;
+        case 'G':   size <<= 30;    ++end;  break;
+    }
+    if (end == text || *end != '\0' || size < 0) {
+        printf("%s: invalid size %s.\n", __progname, text);
+        exit(-1);
+    }
+    return size;
+}
+
+// parse comma separated integers, returns the number of values
+int parse_list(const char * text, int * values) {
+    off_t sizes_of_values[MAX_LIST_LENGTH];
+    int count = parse_size_list(text, sizes_of_values);
+    for (int index = 0 ; index < count ; ++index) values[index] = sizes_of_values[index];
+    return count;
+}
+
+// parse comma separated sizes, returns the number of values
+int parse_size_list(const char * text, off_t * values) {
+    char copy[strlen(text) + 1];
+    strcpy(copy, text);
+    int count = 0;
+    for (char * token = strtok(copy, ",") ; token ; token = strtok(NULL, ",")) {
+        if (count == MAX_LIST_LENGTH) {
+            printf("%s: at most %d values in list %s.\n", __progname, MAX_LIST_LENGTH, text);
+            exit(-1);
+        }
+        values[count++] = parse_size(token);
+    }
+    if (count == 0) {
+        printf("%s: empty list.\n", __progname);
+        exit(-1);
+    }
+    return count;
+}
+
+// print help and exit with given number
+void help(int exit_number) {
+    printf("simple-cp-bench, benchmark simple-cp across types, buffer geometry and file sizes.\n");
+    printf("Usage: simple-cp-bench [options]\n");
+    printf("Must be run in the directory containing simple-cp, writes csv with one row per configuration.\n");
+    printf("Options:\n");
+    printf("-h, --help\tdisplay this help and exit\n");
+    printf("-v, --verbose\texplain what is being done\n");
+    printf("-o, --output\tcsv file, stdout by default\n");
+    printf("-r, --repeat\truns for each configuration(default %d)\n", DEFAULT_REPEAT);
+    printf("--sizes\t\ttest file sizes with K/M/G suffix(default %s)\n", DEFAULT_SIZES);
+    printf("--types\t\ttypes to sweep(default %s)\n", DEFAULT_TYPES);
+    printf("--buffer-capacities\tbuffer capacities to sweep(default %s)\n", DEFAULT_CAPACITIES);
+    printf("--buffer-numbers\tbuffer numbers to sweep(default %s)\n", DEFAULT_NUMBERS);
+    printf("--cold\t\talso run every configuration with source file dropped from page cache\n");
+    printf("--directory\tdirectory for test files(default %s)\n", DEFAULT_DIRECTORY);
+    exit(exit_number);
+}
+
+// create test file with given size filled with pseudo random bytes
+void generate(const char * file, off_t size) {
+    struct stat file_stat;
+    // reuse file generated by previous benchmark
+    if (stat(file, &file_stat) == 0 && file_stat.st_size == size) return;
+
+    int fd = -1;
+    if ((fd = open(file, O_CREAT | O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR)) == -1) {
+        printf("open failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to open file %s for writing.\n", __progname, file);
+        exit(-1);
+    }
+    static unsigned int block[GENERATE_BLOCK_SIZE / sizeof(unsigned int)];
+    unsigned int seed = size;
+    for (off_t written = 0 ; written < size ; ) {
+        for (size_t index = 0 ; index < sizeof(block) / sizeof(block[0]) ; ++index) block[index] = rand_r(&seed);
+        size_t byte_count = size - written < sizeof(block) ? size - written : sizeof(block);
+        ssize_t result = write(fd, block, byte_count);
+        if (result == -1) {
+            printf("write failed: %s.\n", strerror(errno));
+            if (verbose_flag) printf("%s: failed to generate file %s.\n", __progname, file);
+            exit(-1);
+        }
+        written += result;
+    }
+    close(fd);
+    if (verbose_flag) printf("%s: file %s generated with %lld bytes.\n", __progname, file, (long long)size);
+}
+
+// write back and drop cached pages of file, so next run reads it from device
+void drop_cache(const char * file) {
+    int fd = -1;
+    if ((fd = open(file, O_RDONLY)) == -1) {
+        printf("open failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to open file %s for reading.\n", __progname, file);
+        exit(-1);
+    }
+    // dirty pages can't be dropped, write them back first
+    fdatasync(fd);
+    int error = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    if (error && verbose_flag) printf("%s: failed to drop page cache of file %s, %s.\n", __progname, file, strerror(error));
+    close(fd);
+}
+
+// run simple-cp once, returns 0 if it copied successfully
+int run(const char * source, const char * dest, int type, int capacity, int number, struct Run * result) {
+    char type_argument[MAX_INT_ARGUMENT_LENGTH], capacity_argument[MAX_INT_ARGUMENT_LENGTH], number_argument[MAX_INT_ARGUMENT_LENGTH];
+    sprintf(type_argument,      "%d",   type);
+    sprintf(capacity_argument,  "%d",   capacity);
+    sprintf(number_argument,    "%d",   number);
+
+    unlink(dest);
+    // resource usage of children is accumulated, so take the difference around one run
+    // simple-cp waits for its put/get processes, so their usage is included as well
+    struct rusage before, after;
+    struct timespec start, end;
+    getrusage(RUSAGE_CHILDREN, &before);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        printf("fork failed: %s.\n", strerror(errno));
+        exit(-1);
+    }
+    if (pid == 0) {
+        // silence simple-cp, its stdout is not a terminal so no progress bar is printed either
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd != -1) dup2(null_fd, STDOUT_FILENO);
+        execl("./simple-cp", "simple-cp", "-t", type_argument, "--buffer-capacity", capacity_argument, "--buffer-number", number_argument, source, dest, NULL);
+        printf("execl failed: %s.\n", strerror(errno));
+        exit(-1);
+    }
+    int status;
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    getrusage(RUSAGE_CHILDREN, &after);
+
+    result->seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+    result->user_seconds = (after.ru_utime.tv_sec - before.ru_utime.tv_sec) + (after.ru_utime.tv_usec - before.ru_utime.tv_usec) / 1000000.0;
+    result->system_seconds = (after.ru_stime.tv_sec - before.ru_stime.tv_sec) + (after.ru_stime.tv_usec - before.ru_stime.tv_usec) / 1000000.0;
+    result->voluntary_switches = after.ru_nvcsw - before.ru_nvcsw;
+    result->involuntary_switches = after.ru_nivcsw - before.ru_nivcsw;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        if (verbose_flag) printf("%s: simple-cp -t %d --buffer-capacity %d --buffer-number %d failed.\n", __progname, type, capacity, number);
+        return -1;
+    }
+    return 0;
+}
+
+// qsort comparator for runs, faster first
+int compare_seconds(const void * a, const void * b) {
+    double difference = ((const struct Run *)a)->seconds - ((const struct Run *)b)->seconds;
+    return (difference > 0) - (difference < 0);
+}
+
+// run one configuration repeat times and write its csv row
+void benchmark(FILE * output, const char * source, off_t size, int cold, int type, int capacity, int number) {
+    char dest[MAX_PATH_LENGTH];
+    snprintf(dest, sizeof(dest), "%s/simple-cp-bench.dst", directory);
+
+    struct Run runs[MAX_REPEAT];
+    int count = 0, failures = 0;
+    for (int index = 0 ; index < repeat ; ++index) {
+        if (cold) drop_cache(source);
+        if (run(source, dest, type, capacity, number, &runs[count]) == 0) ++count;
+        else ++failures;
+    }
+    unlink(dest);
+
+    // throughput is taken from sorted run time
+    // p95 is the throughput of the run at 95th percentile of run time, i.e. the slow tail
+    double median = 0, p95 = 0;
+    struct Run total = {0, 0, 0, 0, 0};
+    if (count) {
+        qsort(runs, count, sizeof(struct Run), compare_seconds);
+        double median_seconds = count % 2 ? runs[count / 2].seconds : (runs[count / 2 - 1].seconds + runs[count / 2].seconds) / 2;
+        double p95_seconds = runs[(count * 95 + 99) / 100 - 1].seconds;
+        median = size / median_seconds / 1024 / 1024;
+        p95 = size / p95_seconds / 1024 / 1024;
+        for (int index = 0 ; index < count ; ++index) {
+            total.user_seconds += runs[index].user_seconds;
+            total.system_seconds += runs[index].system_seconds;
+            total.voluntary_switches += runs[index].voluntary_switches;
+            total.involuntary_switches += runs[index].involuntary_switches;
+        }
+    }
+    // cpu time and context switches are averaged over successful runs
+    int divisor = count ? count : 1;
+    fprintf(output, "%lld,%s,%d,%d,%d,%d,%d,%.3f,%.3f,%.6f,%.6f,%.1f,%.1f\n",
+            (long long)size, cold ? "cold" : "warm", type, capacity, number, count, failures, median, p95,
+            total.user_seconds / divisor, total.system_seconds / divisor,
+            (double)total.voluntary_switches / divisor, (double)total.involuntary_switches / divisor);
+    fflush(output);
+}
+
+// program entry
+int main(int argc, char * argv[]) {
+    // option structs
+    static struct option options[] = {
+        {"help",                0,  NULL,   'h'},
+        {"verbose",             0,  NULL,   'v'},
+        {"output",              1,  NULL,   'o'},
+        {"repeat",              1,  NULL,   'r'},
+        {"sizes",               1,  NULL,   1},
+        {"types",               1,  NULL,   2},
+        {"buffer-capacities",   1,  NULL,   3},
+        {"buffer-numbers",      1,  NULL,   4},
+        {"cold",                0,  NULL,   5},
+        {"directory",           1,  NULL,   6},
+        {0,                     0,  0,      0}
+    };
+    size_count = parse_size_list(DEFAULT_SIZES, sizes);
+    type_count = parse_list(DEFAULT_TYPES, types);
+    capacity_count = parse_list(DEFAULT_CAPACITIES, capacities);
+    number_count = parse_list(DEFAULT_NUMBERS, numbers);
+    // parse command line options
+    int opt;
+    while ((opt = getopt_long(argc, argv, "hvo:r:", options, NULL)) != -1) {
+        switch (opt) {
+            case 'v':   verbose_flag = 1;                                   break;
+            case 'o':   output_file = optarg;                               break;
+            case 'r':   repeat = atoi(optarg);                              break;
+            case 1:     size_count = parse_size_list(optarg, sizes);        break;
+            case 2:     type_count = parse_list(optarg, types);             break;
+            case 3:     capacity_count = parse_list(optarg, capacities);    break;
+            case 4:     number_count = parse_list(optarg, numbers);         break;
+            case 5:     cold_flag = 1;                                      break;
+            case 6:     directory = optarg;                                 break;
+            case 'h':   help(0);                                            break;
+            case '?':   help(-1);                                           break;
+        }
+    }
+    if (optind != argc) help(-1);
+    if (repeat <= 0 || repeat > MAX_REPEAT) {
+        printf("%s: repeat must between 1 and %d.\n", __progname, MAX_REPEAT);
+        exit(-1);
+    }
+    if (access("./simple-cp", X_OK) == -1) {
+        printf("%s: cannot find simple-cp in current directory.\n", __progname);
+        exit(-1);
+    }
+
+    FILE * output = stdout;
+    if (output_file && (output = fopen(output_file, "w")) == NULL) {
+        printf("fopen failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to open file %s for writing.\n", __progname, output_file);
+        exit(-1);
+    }
+    fprintf(output, "size,cache,type,buffer_capacity,buffer_number,runs,failures,median_mb_s,p95_mb_s,user_seconds,system_seconds,voluntary_switches,involuntary_switches\n");
+
+    // sweep every configuration, warm runs first then cold runs
+    for (int size_index = 0 ; size_index < size_count ; ++size_index) {
+        char source[MAX_PATH_LENGTH];
+        snprintf(source, sizeof(source), "%s/simple-cp-bench-%lld.src", directory, (long long)sizes[size_index]);
+        generate(source, sizes[size_index]);
+        for (int cold = 0 ; cold <= cold_flag ; ++cold)
+            for (int type_index = 0 ; type_index < type_count ; ++type_index)
+                for (int capacity_index = 0 ; capacity_index < capacity_count ; ++capacity_index)
+                    for (int number_index = 0 ; number_index < number_count ; ++number_index)
+                        benchmark(output, source, sizes[size_index], cold, types[type_index], capacities[capacity_index], numbers[number_index]);
+    }
+
+    if (output != stdout) fclose(output);
+    return 0;
+}
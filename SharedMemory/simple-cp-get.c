@@ -1,15 +1,11 @@
 // include system headers
 #include <stdio.h>
 #include <stdlib.h>
-#include <errno.h>
-#include <string.h>
-#include <unistd.h>
-#include <sys/stat.h>
-#include <fcntl.h>
 
 // include user headers
 #include "semaphore.h"
 #include "ring-buffer.h"
+#include "transfer.h"
 
 extern const char * __progname; // gcc defined as substitute for argv[0]
 
@@ -18,26 +14,25 @@ key_t ipc_key; // IPC key
 
 int type; // implementation type
 int buffer_capacity, buffer_number; // buffer capacity and number
+int batch_size; // slots acquired per semaphore operation
+int memory_backend, huge_pages_flag, populate_flag; // shared memory backend and its flags
+int direct_io_flag; // direct io flag
+int stats_flag; // stats flag
+int stream_flag; // stream flag
+int verify_flag; // verify flag
+int sparse_flag; // sparse flag
+int mmap_flag; // mmap flag
+int engine, queue_depth; // ring or io_uring engine and io_uring queue depth
+int consumers; // consumers of ring buffer, dest files of tee mode
+int consumer_index; // consumer of ring buffer this get is, one for each dest file in tee mode
+off_t offset, length; // range of dest file to be written
 const char * file; // dest file name
-
-// private function list
-ssize_t Write(int fildes, const void * buf, size_t nbyte);
-
-// write wrapper
-ssize_t Write(int fildes, const void * buf, size_t nbyte) {
-    int result = -1;
-    if ((result = write(fildes, buf, nbyte)) == -1) {
-        printf("write failed: %s.\n", strerror(errno));
-        if (verbose_flag) printf("%s: failed to write to file %s.\n", __progname, file);
-        exit(-1);
-    }
-    return result;
-}
+const char * source; // source file name, mapped by get in mmap mode
 
 // program entry
 int main(int argc, char * argv[]) {
     // argument validation and casting
-    if (argc != 7) {
+    if (argc != 24) {
         printf("%s: wrong argument number!\n", argv[0]);
         exit(-1);
     }
@@ -46,7 +41,24 @@ int main(int argc, char * argv[]) {
     type = atoi(argv[3]);
     buffer_capacity = atoi(argv[4]);
     buffer_number = atoi(argv[5]);
-    file = argv[6];
+    batch_size = atoi(argv[6]);
+    memory_backend = atoi(argv[7]);
+    huge_pages_flag = atoi(argv[8]);
+    populate_flag = atoi(argv[9]);
+    offset = atoll(argv[10]);
+    length = atoll(argv[11]);
+    engine = atoi(argv[12]);
+    queue_depth = atoi(argv[13]);
+    direct_io_flag = atoi(argv[14]);
+    stats_flag = atoi(argv[15]);
+    stream_flag = atoi(argv[16]);
+    verify_flag = atoi(argv[17]);
+    sparse_flag = atoi(argv[18]);
+    mmap_flag = atoi(argv[19]);
+    file = argv[20];
+    source = argv[21];
+    consumers = atoi(argv[22]);
+    consumer_index = atoi(argv[23]);
 
     // retrieve semaphore set
     int semid = retrieve_semaphore_set(ipc_key);
@@ -55,32 +67,13 @@ int main(int argc, char * argv[]) {
     int shmid = retrieve_ring_buffer(ipc_key);
     struct RingBuffer * ring_buffer = attach_ring_buffer(shmid);
 
-    // open dest file
-    int fd = 0;
-    if ((fd = open(file, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR)) == -1) {
-        printf("open failed: %s.\n", strerror(errno));
-        if (verbose_flag) printf("%s: failed to open file %s for writing.\n", argv[0], file);
-        exit(-1);
-    }
-    if (verbose_flag) printf("%s: file %s opened.\n", argv[0], file);
-
-    // get bytes from shared ring buffer
-    int byte_count; // byte number that read from ring buffer
-    char bytes[buffer_capacity]; // temp buffer
-    do {
-        if (type == 1) semaphore_p(semid, FULL_SLOTS); // full slots minus 1
-        // semaphore_p(semid, MUTEX_LOCK); // mutex lock acquired
-        consume(ring_buffer, &byte_count, bytes);
-        // semaphore_v(semid, MUTEX_LOCK); // mutex lock released
-        // unnecessary for mutex
-        if (type == 1) semaphore_v(semid, EMPTY_SLOTS); // empty slots add 1
-        if (verbose_flag) printf("%s: %d bytes read from ring buffer.\n", argv[0], byte_count);
-    } while(Write(fd, bytes, byte_count) != 0); // write from temp buffer to file
-    // use byte count to indicate end of file
+    // get bytes of range from shared ring buffer
+    struct Transfer transfer = {ring_buffer, semid, file, offset, length};
+    transfer.source = source;
+    get_range(&transfer);
     if (verbose_flag) printf("%s: get process succeeded.\n", __progname);
 
     // clean up
-    close(fd);
     deattach_ring_buffer(ring_buffer);
 
     return 0;
@@ -0,0 +1,447 @@
+// include system headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ipc.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+
+// include user headers
+#include "semaphore.h" // semaphore
+#include "ring-buffer.h" // ring buffer
+#include "kernel-copy.h" // engine numbers
+#include "transfer.h" // put/get loops
+#include "server.h" // client protocol
+
+// const definition
+#define DEFAULT_BUFFER_CAPACITY 65536 // default buffer capacity
+#define DEFAULT_BUFFER_NUMBER 16 // default buffer number
+#define DEFAULT_BATCH_SIZE 1 // default slots acquired per semaphore operation
+#define DEFAULT_PAIRS 4 // default put/get pairs of pool
+#define MAX_PAIRS 64 // max put/get pairs of pool
+#define DEFAULT_CHUNK_SIZE (8 << 20) // bytes of a job copied before next job gets its turn
+#define LISTEN_BACKLOG 128 // pending connections of listening socket
+
+// global variables, the ones put/get loops read are the same as put/get processes'
+extern const char * __progname; // gcc defined as substitute for argv[0]
+
+int verbose_flag = 0; // verbose flag
+key_t ipc_key = IPC_PRIVATE; // IPC key, pool is private to server so keys never collide
+
+int type = 1; // default type is semaphore implementation
+int buffer_capacity = DEFAULT_BUFFER_CAPACITY; // buffer capacity
+int buffer_number = DEFAULT_BUFFER_NUMBER; // buffer number
+int batch_size = DEFAULT_BATCH_SIZE; // slots acquired per semaphore operation
+int memory_backend = 0, huge_pages_flag = 0, populate_flag = 0; // shared memory backend and its flags
+int direct_io_flag = 0; // direct io flag
+int stats_flag = 0; // stats flag
+int stream_flag = 0; // stream flag
+int verify_flag = 0; // verify flag
+int sparse_flag = 1; // sparse flag
+int mmap_flag = 0; // mmap flag
+int consumers = 1, consumer_index = 0; // no tee mode, a pair is the only producer and consumer of its ring buffer
+int engine = ENGINE_RING, queue_depth = 0; // ring engine only
+int pairs = DEFAULT_PAIRS; // put/get pairs of pool
+off_t chunk_size = DEFAULT_CHUNK_SIZE; // bytes a pair copies of a job at a time
+const char * socket_path = NULL; // path of listening socket
+int listen_fd = -1; // listening socket
+
+// a submitted copy, split into chunks claimed round robin with other jobs
+struct Job {
+    size_t id;
+    int client; // connection progress and result are written to
+    char * source, * dest;
+    off_t size; // size of source
+    off_t claimed; // start of next chunk to claim
+    off_t done; // bytes of chunks written
+    struct timespec start;
+    struct Job * next, * previous; // ring of jobs with chunks left to claim
+};
+
+// a range of a job
+struct Chunk {
+    struct Job * job;
+    off_t offset, length;
+};
+
+// a long-lived put/get pair of pool, same hand-off as directory mode: put claims chunks and hands them
+// to get in order, it is never more than buffer number + 1 chunks ahead of get
+struct Pair {
+    struct Transfer put, get;
+    struct RingBuffer * ring_buffer;
+    struct Chunk * pending; // chunks claimed by put and not yet started by get
+    size_t head, tail; // pop and push position of pending
+    pthread_mutex_t mutex;
+    pthread_cond_t claimed; // get waits for put to claim a chunk
+    pthread_t threads[2];
+};
+
+struct Pair pair_list[MAX_PAIRS]; // pool
+pthread_mutex_t schedule_mutex = PTHREAD_MUTEX_INITIALIZER; // guards job ring
+pthread_cond_t scheduled = PTHREAD_COND_INITIALIZER; // put waits for a job to be scheduled
+struct Job * cursor = NULL; // job next chunk is claimed from, NULL if no chunk is left
+pthread_mutex_t report_mutex = PTHREAD_MUTEX_INITIALIZER; // guards done bytes and client connections
+size_t job_count = 0; // jobs accepted so far
+
+// function list
+void help(int exit_number) __attribute__((noreturn));
+void clean_and_exit(int exit_number) __attribute__((noreturn));
+void error_handler(int sig);
+
+void remove_semaphore_sets(void);
+void validation(void);
+void initialize(void);
+void send_message(int client, int flags, const char * format, ...) __attribute__((format(printf, 3, 4)));
+struct Job * receive_job(int client);
+void schedule_job(struct Job * job);
+struct Chunk claim_chunk(void);
+void finish_chunk(struct Chunk * chunk);
+void * put_chunks(void * argument);
+void * get_chunks(void * argument);
+void serve(void);
+
+// print help and exit with given number
+void help(int exit_number) {
+    printf("simple-cp-server, a copy server keeping a pool of ring buffers and put/get threads alive.\n");
+    printf("Usage: simple-cp-server [options] [SOCKET]\n");
+    printf("Jobs are submitted with simple-cp --server SOCKET, chunks of all jobs are copied round robin.\n");
+    printf("Options:\n");
+    printf("-h, --help\tdisplay this help and exit\n");
+    printf("-v, --verbose\texplain what is being done\n");
+    printf("-t, --type\t1 - semaphore 2 - retry loop 3 - lock-free spsc 4 - spin-then-futex other - none\n");
+    printf("-j, --pairs\tspecify put/get pairs of pool\n");
+    printf("--buffer-capacity\tspecify buffer capacity (byte)\n");
+    printf("--buffer-number\tspecify buffer number\n");
+    printf("--batch-size\tspecify slots acquired per semaphore operation(type 1 only)\n");
+    printf("--chunk-size\tspecify bytes of a job copied before next job gets its turn\n");
+    exit(exit_number);
+}
+
+// remove semaphore sets and socket and exit with given number, private ring buffers go with process
+void clean_and_exit(int exit_number) {
+    remove_semaphore_sets();
+    if (listen_fd != -1) unlink(socket_path);
+    if (verbose_flag) printf("%s: finished clean process.\n", __progname);
+    exit(exit_number);
+}
+
+void error_handler(int sig) {
+    remove_semaphore_sets();
+    if (listen_fd != -1) unlink(socket_path);
+    // reactive signal to set right return status
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+// atexit handler too, put/get threads exit the whole server on error, private semaphore sets must not be left behind
+void remove_semaphore_sets(void) {
+    for (int index = 0 ; index < pairs ; ++index) remove_semaphore_set(pair_list[index].put.semid);
+}
+
+void validation(void) {
+    if (buffer_number <= 0 || buffer_capacity <= 0) {
+        printf("%s: buffer number/capacity must greater than 0.\n", __progname);
+        exit(-1);
+    }
+    if (batch_size <= 0 || batch_size > buffer_number) {
+        printf("%s: batch size must between 1 and buffer number.\n", __progname);
+        exit(-1);
+    }
+    if (pairs <= 0 || pairs > MAX_PAIRS) {
+        printf("%s: pairs must between 1 and %d.\n", __progname, MAX_PAIRS);
+        exit(-1);
+    }
+    if (chunk_size <= 0) {
+        printf("%s: chunk size must greater than 0.\n", __progname);
+        exit(-1);
+    }
+    if (strlen(socket_path) >= sizeof(((struct sockaddr_un *)0)->sun_path)) {
+        printf("%s: socket path %s is too long.\n", __progname, socket_path);
+        exit(-1);
+    }
+}
+
+// create ring buffers and start put/get threads of pool, then listen on socket
+void initialize(void) {
+    for (int index = 0 ; index < pairs ; ++index) pair_list[index].put.semid = pair_list[index].get.semid = -1;
+    signal(SIGINT, error_handler);
+    signal(SIGTERM, error_handler);
+    atexit(remove_semaphore_sets);
+
+    for (int index = 0 ; index < pairs ; ++index) {
+        struct Pair * pair = &pair_list[index];
+        // threads share a private mapping, only semaphore implementation needs a(private) semaphore set
+        pair->ring_buffer = create_private_ring_buffer();
+        if (type == 1) pair->put.semid = pair->get.semid = create_semaphore_set(buffer_number);
+        pair->put.ring_buffer = pair->get.ring_buffer = pair->ring_buffer;
+        pair->pending = malloc((buffer_number + 1) * sizeof(struct Chunk));
+        pthread_mutex_init(&pair->mutex, NULL);
+        pthread_cond_init(&pair->claimed, NULL);
+        if (pthread_create(&pair->threads[0], NULL, put_chunks, pair) != 0 ||
+            pthread_create(&pair->threads[1], NULL, get_chunks, pair) != 0) {
+            printf("pthread_create failed.\n");
+            if (verbose_flag) printf("%s: failed to create put/get threads.\n", __progname);
+            clean_and_exit(-1);
+        }
+    }
+    if (verbose_flag) printf("%s: %d put/get pairs started.\n", __progname, pairs);
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+    // socket left behind by a server that was killed
+    unlink(socket_path);
+    if ((listen_fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1 ||
+        bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) == -1 ||
+        listen(listen_fd, LISTEN_BACKLOG) == -1) {
+        printf("socket failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to listen on %s.\n", __progname, socket_path);
+        clean_and_exit(-1);
+    }
+    if (verbose_flag) printf("%s: listening on %s.\n", __progname, socket_path);
+}
+
+// write a line to client, a client that has gone away doesn't stop its copy
+// with MSG_DONTWAIT in flags, a line that would block is dropped instead
+void send_message(int client, int flags, const char * format, ...) {
+    char message[MAX_MESSAGE_LENGTH];
+    va_list arguments;
+    va_start(arguments, format);
+    int length = vsnprintf(message, sizeof(message), format, arguments);
+    va_end(arguments);
+    if (length >= (int)sizeof(message)) length = sizeof(message) - 1;
+    send(client, message, length, MSG_NOSIGNAL | flags);
+}
+
+// read source/dest of a copy and get dest ready, NULL after telling client why not
+// source and dest are checked here so that put/get threads, which exit the server on error, never see a bad one
+struct Job * receive_job(int client) {
+    char request[MAX_REQUEST_LENGTH];
+    size_t size = 0, terminators = 0;
+    while (terminators < 2 && size < sizeof(request)) {
+        ssize_t count = recv(client, request + size, sizeof(request) - size, 0);
+        if (count == -1 && errno == EINTR) continue;
+        if (count <= 0) break;
+        for (ssize_t index = 0 ; index < count ; ++index) if (request[size + index] == '\0') ++terminators;
+        size += count;
+    }
+    if (terminators < 2) {
+        send_message(client, 0, "error malformed request\n");
+        return NULL;
+    }
+    const char * source = request, * dest = request + strlen(request) + 1;
+    if (source[0] != '/' || dest[0] != '/') {
+        send_message(client, 0, "error paths must be absolute\n");
+        return NULL;
+    }
+
+    struct stat source_stat, dest_stat;
+    if (stat(source, &source_stat) == -1 || access(source, R_OK) == -1) {
+        send_message(client, 0, "error cannot access source file %s, %s\n", source, strerror(errno));
+        return NULL;
+    }
+    if (!S_ISREG(source_stat.st_mode)) {
+        send_message(client, 0, "error source file %s is not a regular file\n", source);
+        return NULL;
+    }
+    // dest is truncated before copy, copying a file onto itself would lose it
+    if (stat(dest, &dest_stat) == 0 && source_stat.st_dev == dest_stat.st_dev && source_stat.st_ino == dest_stat.st_ino) {
+        send_message(client, 0, "error %s and %s are the same file\n", source, dest);
+        return NULL;
+    }
+    // dest gets its final size up front so that chunks can be written in any order, holes stay holes
+    int fd = open(dest, O_CREAT | O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd == -1 || ftruncate(fd, source_stat.st_size) == -1) {
+        send_message(client, 0, "error cannot create dest file %s, %s\n", dest, strerror(errno));
+        if (fd != -1) close(fd);
+        return NULL;
+    }
+    close(fd);
+
+    struct Job * job = calloc(1, sizeof(struct Job));
+    job->id = ++job_count;
+    job->client = client;
+    job->source = strdup(source);
+    job->dest = strdup(dest);
+    job->size = source_stat.st_size;
+    clock_gettime(CLOCK_MONOTONIC, &job->start);
+    if (verbose_flag) printf("%s: job %zu copies %s to %s(%lld bytes).\n", __progname, job->id, job->source, job->dest, (long long)job->size);
+    return job;
+}
+
+// append job to the end of round
+void schedule_job(struct Job * job) {
+    pthread_mutex_lock(&schedule_mutex);
+    if (cursor == NULL) {
+        job->next = job->previous = job;
+        cursor = job;
+    } else {
+        job->next = cursor;
+        job->previous = cursor->previous;
+        cursor->previous->next = job;
+        cursor->previous = job;
+    }
+    pthread_cond_broadcast(&scheduled);
+    pthread_mutex_unlock(&schedule_mutex);
+}
+
+// take next chunk of job at cursor and move cursor to next job, so that every job gets a chunk
+// in turn no matter how large the others are, a job leaves the ring with its last chunk
+struct Chunk claim_chunk(void) {
+    pthread_mutex_lock(&schedule_mutex);
+    while (cursor == NULL) pthread_cond_wait(&scheduled, &schedule_mutex);
+    struct Job * job = cursor;
+    struct Chunk chunk = {job, job->claimed, job->size - job->claimed < chunk_size ? job->size - job->claimed : chunk_size};
+    job->claimed += chunk.length;
+    if (job->claimed < job->size) {
+        cursor = job->next;
+    } else if (job->next == job) {
+        cursor = NULL;
+    } else {
+        job->previous->next = job->next;
+        job->next->previous = job->previous;
+        cursor = job->next;
+    }
+    pthread_mutex_unlock(&schedule_mutex);
+    return chunk;
+}
+
+// report progress of job, and its result once its last chunk is written
+void finish_chunk(struct Chunk * chunk) {
+    struct Job * job = chunk->job;
+    pthread_mutex_lock(&report_mutex);
+    job->done += chunk->length;
+    int finished = job->done == job->size;
+    // report mutex is shared by all jobs, a client not reading must not stall workers of the others
+    // progress is only sent once client has read the previous line, so there's always room left for
+    // done line below, which is sent blocking outside of mutex, a skipped line is superseded by the next
+    // progress line is short enough for unix socket to take it whole or not at all
+    int queued = 0;
+    if (!finished && ioctl(job->client, SIOCOUTQ, &queued) == 0 && queued == 0) send_message(job->client, MSG_DONTWAIT, "progress %lld %lld\n", (long long)job->done, (long long)job->size);
+    pthread_mutex_unlock(&report_mutex);
+    if (!finished) return;
+
+    // chunks of a job are all claimed before its last one is written, no other thread refers to it now
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double duration = (end.tv_sec - job->start.tv_sec) + (end.tv_nsec - job->start.tv_nsec) / 1000000000.0;
+    send_message(job->client, 0, "done %lld %.3f\n", (long long)job->size, duration);
+    if (verbose_flag) printf("%s: job %zu finished in %.3f seconds.\n", __progname, job->id, duration);
+    close(job->client);
+    free(job->source);
+    free(job->dest);
+    free(job);
+}
+
+// claim chunks forever, put each of them to ring buffer after telling get which one it is
+void * put_chunks(void * argument) {
+    struct Pair * pair = argument;
+    for (;;) {
+        struct Chunk chunk = claim_chunk();
+        pthread_mutex_lock(&pair->mutex);
+        pair->pending[pair->tail++ % (buffer_number + 1)] = chunk;
+        pthread_cond_signal(&pair->claimed);
+        pthread_mutex_unlock(&pair->mutex);
+
+        pair->put.file = chunk.job->source;
+        pair->put.offset = chunk.offset;
+        pair->put.length = chunk.length;
+        put_range(&pair->put);
+    }
+    return NULL;
+}
+
+// get chunks in the order put claimed them
+void * get_chunks(void * argument) {
+    struct Pair * pair = argument;
+    for (;;) {
+        pthread_mutex_lock(&pair->mutex);
+        while (pair->head == pair->tail) pthread_cond_wait(&pair->claimed, &pair->mutex);
+        struct Chunk chunk = pair->pending[pair->head++ % (buffer_number + 1)];
+        pthread_mutex_unlock(&pair->mutex);
+
+        pair->get.file = chunk.job->dest;
+        pair->get.offset = chunk.offset;
+        pair->get.length = chunk.length;
+        get_range(&pair->get);
+        finish_chunk(&chunk);
+    }
+    return NULL;
+}
+
+// accept clients forever, each connection submits one job
+void serve(void) {
+    for (;;) {
+        int client = accept(listen_fd, NULL, NULL);
+        if (client == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            printf("accept failed: %s.\n", strerror(errno));
+            if (verbose_flag) printf("%s: failed to accept client.\n", __progname);
+            clean_and_exit(-1);
+        }
+        struct Job * job = receive_job(client);
+        if (job == NULL) {
+            close(client);
+        } else if (job->size == 0) {
+            // nothing to schedule, dest has already been created empty
+            struct Chunk chunk = {job, 0, 0};
+            finish_chunk(&chunk);
+        } else {
+            schedule_job(job);
+        }
+    }
+}
+
+// program entry
+int main(int argc, char * argv[]) {
+    // option structs
+    static struct option options[] = {
+        {"help",            0,  NULL,   'h'},
+        {"verbose",         0,  NULL,   'v'},
+        {"type",            1,  NULL,   't'},
+        {"pairs",           1,  NULL,   'j'},
+        {"buffer-capacity", 1,  NULL,   1},
+        {"buffer-number",   1,  NULL,   2},
+        {"batch-size",      1,  NULL,   3},
+        {"chunk-size",      1,  NULL,   4},
+        {0,                 0,  0,      0}
+    };
+    // parse command line options
+    int opt;
+    while ((opt = getopt_long(argc, argv, "hvt:j:", options, NULL)) != -1) {
+        switch (opt) {
+            case 'v':   verbose_flag = 1;                   break;
+            case 't':   type = atoi(optarg);                break;
+            case 'j':   pairs = atoi(optarg);               break;
+            case 1:     buffer_capacity = atoi(optarg);     break;
+            case 2:     buffer_number = atoi(optarg);       break;
+            case 3:     batch_size = atoi(optarg);          break;
+            case 4:     chunk_size = atoll(optarg);         break;
+            case 'h':   help(0);                            break;
+            case '?':   help(-1);                           break;
+        }
+    }
+    // acquire command line arguments
+    if (optind >= argc) {
+        printf("%s: socket path expected.\n", argv[0]);
+        exit(-1);
+    }
+    socket_path = argv[optind];
+
+    validation();
+    initialize();
+    serve();
+}
@@ -1,3 +1,6 @@
+// SEEK_DATA/SEEK_HOLE and cpu_set_t need gnu extensions
+#define _GNU_SOURCE
+
 // include system headers
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,19 +15,36 @@
 #include <sys/sem.h>
 #include <sys/shm.h>
 #include <sys/stat.h>
-#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
 #include <time.h>
 
 // include user headers
 #include "ring-buffer.h" // ring buffer
 #include "semaphore.h" // semaphore
+#include "kernel-copy.h" // kernel fast-path engines
+#include "progress.h" // progress bar
+#include "transfer.h" // put/get loops shared with put/get processes
+#include "crc32c.h" // digests of verify mode
+#include "transform.h" // transforms of pipeline mode
+#include "directory.h" // directory mode
+#include "tuning.h" // geometry candidates of auto mode
+#include "affinity.h" // cpu placement
+#include "server.h" // protocol of simple-cp-server
 
 // const definition
 #define DEFAULT_BUFFER_CAPACITY 256 // default buffer capacity
 #define DEFAULT_BUFFER_NUMBER 8 // default buffer number
+#define DEFAULT_BATCH_SIZE 1 // default slots acquired per semaphore operation
+#define DEFAULT_QUEUE_DEPTH 4 // default io_uring queue depth
+#define MAX_QUEUE_DEPTH 4096 // max io_uring queue depth
+#define DEFAULT_WORKERS 2 // default transform workers of pipeline mode
+#define MAX_WORKERS 64 // max transform workers of pipeline mode
 
 #define MAX_INT_ARGUMENT_LENGTH 12 // max integer arument length
-#define REFRESH_TIME_INTERVAL 100 // minimal time interval(micro seconds) to update progress bar
+#define MAX_LONG_ARGUMENT_LENGTH 21 // max long integer argument length
+#define MAX_JOBS 64 // max put/get pairs, each job uses its own IPC key 'c' + index
 
 // global variables
 extern const char  * __progname; // gcc defined as substitute for argv[0]
@@ -34,26 +54,81 @@ key_t ipc_key = -1; // IPC key
 
 int buffer_capacity = DEFAULT_BUFFER_CAPACITY; // buffer capacity
 int buffer_number = DEFAULT_BUFFER_NUMBER; // buffer number
-int semid = -1; // semaphore id
-int shmid = -1; // rinb buffer(shared memory) id
+int batch_size = DEFAULT_BATCH_SIZE; // slots acquired per semaphore operation
+int memory_backend = 0; // default shared memory backend is System V
+int huge_pages_flag = 0; // huge pages flag
+int populate_flag = 0; // prefault flag
+int engine = ENGINE_RING; // default engine is ring buffer with put/get processes
+size_t kernel_transferred_size = 0; // bytes copied by kernel engines, or by probes of auto mode
+int queue_depth = DEFAULT_QUEUE_DEPTH; // io_uring requests in flight for each put/get process
+int direct_io_flag = 0; // direct io flag
+int stats_flag = 0; // stats flag
+int stream_flag = 0; // stream flag, turned on as well if source or dest isn't a regular file
+int verify_flag = 0; // verify flag, put/get digest what they read/write
+int transform = TRANSFORM_NONE; // pipeline mode transform, none means plain copy
+int workers = DEFAULT_WORKERS; // transform workers of pipeline mode
+int sparse_flag = 1; // sparse flag, holes of source are skipped instead of copied as zeros
+int mmap_flag = 0; // mmap flag, put only publishes extents and get writes them from its mapping of source
+int recursive_flag = 0; // copy a directory tree, files are queued and shared by long-lived put/get pairs
+int auto_flag = 0; // auto mode, buffer geometry is chosen by copying first ranges of source with candidates
+size_t probe_skipped_size = 0; // bytes of holes skipped by probes of auto mode
+uint32_t probe_source_digest = 0, probe_dest_digest = 0; // digests of ranges copied by probes of auto mode
+int jobs = 1; // put/get pairs, each one copies its own range with its own ring buffer
+key_t ipc_keys[MAX_JOBS]; // IPC keys
+int semids[MAX_JOBS]; // semaphore ids
+int shmids[MAX_JOBS]; // rinb buffer(shared memory) ids
+int threads_flag = 0; // run put/get as threads of current process instead of processes
+struct RingBuffer * private_ring_buffers[MAX_JOBS]; // ring buffers of threads mode
+struct Transfer transfers[MAX_JOBS][2]; // put/get ranges of threads mode
+pthread_t threads[MAX_JOBS][2]; // put/get threads of threads mode
+const char * cpu_list = NULL; // cpus of put/get of each job in order, or auto for cache siblings
+int job_cpus[MAX_JOBS * (MAX_CONSUMERS + 1)]; // cpu of put and gets of each job in order, CPU_NONE if not pinned
+int progress_cpu = CPU_NONE; // cpu of progress thread
+const char * server_socket = NULL; // submit copy to simple-cp-server listening on this socket instead
 char * source_file = NULL; // source file name
 off_t source_file_size = 0; // source file size
-char * dest_file = NULL; // dest file name
+char * dest_file = NULL; // dest file name, the first one in tee mode
+char * dest_files[MAX_CONSUMERS]; // dest file names, each job has a get for each of them in tee mode
+int consumers = 1; // dest files, more than one makes ring buffer of each job a tee ring buffer
+int consumer_index = 0; // simple-cp's own threads only run without tee mode, put and get threads alike
 int type = 1; // default type is semaphore implementation
 
 // function list
 pid_t Fork(void);
 
+int parse_memory_backend(const char * name);
+int parse_engine(const char * name);
+int parse_transform(const char * name);
+
 void help(int exit_number) __attribute__((noreturn));
 void clean_and_exit(int exit_number) __attribute__((noreturn));
 
 void validation(void);
 void initialize(void);
+void create_ipc_objects(void);
+void delete_ipc_objects(void);
+void place_jobs(void);
+int job_cpu(int job, int consumer);
+void preallocate(const char * file);
+pid_t spawn(const char * program, int job, off_t offset, off_t length, const char * file, int consumer);
+void wait_children(void);
+void * put_thread(void * argument);
+void * get_thread(void * argument);
+void start_threads(int job, off_t offset, off_t length);
+void wait_threads(void);
+void remove_semaphore_sets(void);
+void start_jobs(off_t begin, off_t end);
+void wait_jobs(void);
+struct RingBuffer * job_ring_buffer(int job);
+off_t auto_tune(void);
+void copy_in_kernel(void);
+int verify(struct RingBuffer ** ring_buffers);
 void process(void);
 
-void error_handler(int sig);
+char * absolute_path(const char * path);
+void submit_job(void) __attribute__((noreturn));
 
-void * print_progress(void * argument);
+void error_handler(int sig);
 
 // fork wrapper
 pid_t Fork(void) {
@@ -65,23 +140,72 @@ pid_t Fork(void) {
     return pid;
 }
 
+// convert shared memory backend name to its number
+int parse_memory_backend(const char * name) {
+    if (strcmp(name, "sysv") == 0) return 0;
+    if (strcmp(name, "posix") == 0) return 1;
+    if (strcmp(name, "memfd") == 0) return 2;
+    printf("%s: unknown shared memory backend %s.\n", __progname, name);
+    exit(-1);
+}
+
+// convert engine name to its number
+int parse_engine(const char * name) {
+    if (strcmp(name, "ring") == 0) return ENGINE_RING;
+    if (strcmp(name, "copy_file_range") == 0) return ENGINE_COPY_FILE_RANGE;
+    if (strcmp(name, "splice") == 0) return ENGINE_SPLICE;
+    if (strcmp(name, "sendfile") == 0) return ENGINE_SENDFILE;
+    if (strcmp(name, "uring") == 0) return ENGINE_URING;
+    printf("%s: unknown engine %s.\n", __progname, name);
+    exit(-1);
+}
+
+// convert transform name to its number
+int parse_transform(const char * name) {
+    if (strcmp(name, "gzip") == 0) return TRANSFORM_GZIP;
+    if (strcmp(name, "upper") == 0) return TRANSFORM_UPPER;
+    printf("%s: unknown transform %s.\n", __progname, name);
+    exit(-1);
+}
+
 // print help and exit with given number
 void help(int exit_number) {
     printf("simple-cp, a simple cp implementation with IPC(Inter-process Communication).\n");
-    printf("Usage: simple-cp [options] [SOURCE FILE] [DEST FILE]\n");
+    printf("Usage: simple-cp [options] [SOURCE FILE] [DEST FILE]...\n");
+    printf("Several dest files make a tee copy, source is read once and each job has a get for each dest file(at most %d, ring engines only, no directory, pipeline, threads or auto mode)\n", MAX_CONSUMERS);
     printf("Options:\n");
     printf("-h, --help\tdisplay this help and exit\n");
     printf("-v, --verbose\texplain what is being done\n");
-    printf("-t, --type\t1 - semaphore 2 - retry loop other - none\n");
+    printf("-t, --type\t1 - semaphore 2 - retry loop 3 - lock-free spsc 4 - spin-then-futex other - none\n");
     printf("--buffer-capacity\tspecify buffer capacity (byte)\n");
     printf("--buffer-number\tspecify buffer number\n");
+    printf("--batch-size\tspecify slots acquired per semaphore operation(type 1 only)\n");
+    printf("--memory\tshared memory backend, sysv(default) posix or memfd\n");
+    printf("--huge-pages\tback ring buffer with huge pages\n");
+    printf("--populate\tprefault ring buffer pages before copy\n");
+    printf("-j, --jobs\tsplit file into N ranges copied by N put/get pairs\n");
+    printf("-r, --recursive\tcopy directory tree, -j put/get thread pairs take files from a shared queue and reuse their ring buffers\n");
+    printf("--engine\tring(default), uring for ring with io_uring put/get, or copy_file_range/splice/sendfile to copy inside kernel(single job)\n");
+    printf("--queue-depth\tio_uring requests in flight for put/get(uring engine only)\n");
+    printf("--stats\t\tprint ring buffer stalls, occupancy and read/write latency after copy\n");
+    printf("--threads\trun put/get as threads of simple-cp over private memory, no fork/exec or IPC keys\n");
+    printf("--stream\tpack reads into a byte-stream ring instead of fixed slots, for pipes, FIFOs and sockets(single job, ring engine only)\n");
+    printf("--verify\tcompute crc32c of source and dest while copying and compare them(ring engines only)\n");
+    printf("--transform\tgzip or upper, transform slots in parallel with worker threads and write them in order(threads mode, single job, gzip slots are at least 1MB)\n");
+    printf("--workers\tspecify transform workers(pipeline mode only)\n");
+    printf("--mmap\t\tput only publishes extents of source and get writes them from its own mapping of it, slots carry no bytes so a small buffer capacity will do(ring engine only, no verify)\n");
+    printf("--no-sparse\tcopy holes of source as zeros instead of skipping them\n");
+    printf("--cpus\t\tpin put/get of job 0, 1, ... to a cpu list like 0,2,4-7(reused if too short), or auto for cores sharing a cache, ring buffer memory is placed on their node\n");
+    printf("--progress-cpu\tpin progress thread to a cpu\n");
+    printf("--server\tsubmit copy to simple-cp-server listening on a socket and follow its progress\n");
+    printf("--auto\t\tchoose buffer capacity and number from block sizes of source/dest, then keep the fastest of a few tried on first ranges of source(overrides --buffer-capacity/--buffer-number)\n");
+    printf("--direct\tbypass page cache with O_DIRECT, buffer capacity must be a multiple of page size\n");
     exit(exit_number);
 }
 
 // clean(remove semaphore set/delete ring buffer) and exit with given number
 void clean_and_exit(int exit_number) {
-    remove_semaphore_set(semid);
-    delete_ring_buffer(shmid);
+    delete_ipc_objects();
     if (verbose_flag) printf("%s: finished clean process.\n", __progname);
     exit(exit_number);
 }
@@ -92,86 +216,313 @@ void validation(void) {
         printf("%s: buffer number/capacity must greater than 0.\n", __progname);
         exit(-1);
     }
+    if (jobs <= 0 || jobs > MAX_JOBS) {
+        printf("%s: jobs must between 1 and %d.\n", __progname, MAX_JOBS);
+        exit(-1);
+    }
+    // auto mode starts from its first guess instead of given geometry, slots are never fewer than batch size or queue depth
+    if (auto_flag) {
+        buffer_capacity = initial_capacity(source_file, dest_file, direct_io_flag ? slot_alignment() : AUTO_MIN_CAPACITY);
+        buffer_number = auto_number(buffer_capacity, batch_size > queue_depth ? batch_size : queue_depth);
+    }
+    if (engine == ENGINE_URING && (queue_depth <= 0 || queue_depth > buffer_number || queue_depth > MAX_QUEUE_DEPTH)) {
+        printf("%s: queue depth must between 1 and buffer number(at most %d).\n", __progname, MAX_QUEUE_DEPTH);
+        exit(-1);
+    }
+    if (direct_io_flag && buffer_capacity % slot_alignment() != 0) {
+        printf("%s: buffer capacity must be a multiple of %zu in direct io mode.\n", __progname, slot_alignment());
+        exit(-1);
+    }
+    if (batch_size <= 0 || batch_size > buffer_number) {
+        printf("%s: batch size must between 1 and buffer number.\n", __progname);
+        exit(-1);
+    }
     if (access(source_file, R_OK) == -1) {
         printf("%s: cannot access source file %s.\n", __progname, source_file);
         exit(-1);
     }
+    // dest is truncated before copy, copying a file onto itself would lose it, so would two gets writing the same dest
+    struct stat source_stat, dest_stat, other_stat;
+    for (int consumer = 0 ; consumer < consumers ; ++consumer) {
+        if (stat(dest_files[consumer], &dest_stat) == -1) continue;
+        if (stat(source_file, &source_stat) == 0 && source_stat.st_dev == dest_stat.st_dev && source_stat.st_ino == dest_stat.st_ino) {
+            printf("%s: %s and %s are the same file.\n", __progname, source_file, dest_files[consumer]);
+            exit(-1);
+        }
+        for (int other = 0 ; other < consumer ; ++other) {
+            if (stat(dest_files[other], &other_stat) == 0 && other_stat.st_dev == dest_stat.st_dev && other_stat.st_ino == dest_stat.st_ino) {
+                printf("%s: %s and %s are the same file.\n", __progname, dest_files[other], dest_files[consumer]);
+                exit(-1);
+            }
+        }
+    }
+    // tee mode, one put and a get for each dest file in each job, all of them processes
+    if (consumers > 1 && (recursive_flag || transform != TRANSFORM_NONE || threads_flag || auto_flag || !ENGINE_USES_RING(engine))) {
+        printf("%s: tee mode only works with ring engines and without directory, pipeline, threads or auto mode.\n", __progname);
+        exit(-1);
+    }
+    // pipes, FIFOs, sockets and devices can only be read/written sequentially, copy them in stream mode
+    struct stat file_stat;
+    int source_regular = stat(source_file, &file_stat) == 0 && S_ISREG(file_stat.st_mode);
+    int dest_regular = 1;
+    for (int consumer = 0 ; consumer < consumers ; ++consumer) {
+        if (stat(dest_files[consumer], &file_stat) == 0 && !S_ISREG(file_stat.st_mode)) dest_regular = 0;
+    }
+    int source_directory = stat(source_file, &file_stat) == 0 && S_ISDIR(file_stat.st_mode);
+    if (source_directory && !recursive_flag) {
+        printf("%s: source file %s is a directory, use -r to copy it.\n", __progname, source_file);
+        exit(-1);
+    }
+    if (recursive_flag && !source_directory) {
+        printf("%s: source file %s is not a directory.\n", __progname, source_file);
+        exit(-1);
+    }
+    // directory mode, files of any size come and go on the same put/get threads and ring buffers
+    if (recursive_flag) {
+        if (stream_flag || transform != TRANSFORM_NONE || verify_flag || !ENGINE_USES_RING(engine)) {
+            printf("%s: directory mode only works with ring engines and without stream, pipeline or verify mode.\n", __progname);
+            exit(-1);
+        }
+        if (verbose_flag && !threads_flag) printf("%s: directory mode runs in threads mode.\n", __progname);
+        threads_flag = 1;
+    } else if (transform != TRANSFORM_NONE) {
+        // pipeline mode writes dest sequentially anyway, only its source must be a regular file
+        if (!source_regular || stream_flag || jobs != 1 || !ENGINE_USES_RING(engine) || verify_flag) {
+            printf("%s: pipeline mode only works with a regular source file, a single job, ring engines and without stream or verify mode.\n", __progname);
+            exit(-1);
+        }
+        if (workers <= 0 || workers > MAX_WORKERS) {
+            printf("%s: workers must between 1 and %d.\n", __progname, MAX_WORKERS);
+            exit(-1);
+        }
+        if (transform == TRANSFORM_GZIP && buffer_capacity < GZIP_MIN_CAPACITY) {
+            if (verbose_flag) printf("%s: buffer capacity raised to %d for gzip.\n", __progname, GZIP_MIN_CAPACITY);
+            buffer_capacity = GZIP_MIN_CAPACITY;
+        }
+        // transform needs every byte in order, holes included
+        sparse_flag = 0;
+        // workers share transformed slots in memory of simple-cp
+        if (verbose_flag && !threads_flag) printf("%s: pipeline mode runs in threads mode.\n", __progname);
+        threads_flag = 1;
+    } else if (!source_regular || !dest_regular) {
+        if (verbose_flag && !stream_flag) printf("%s: source or dest file is not a regular file, stream mode on.\n", __progname);
+        stream_flag = 1;
+    }
+    if (stream_flag && (jobs != 1 || engine != ENGINE_RING || direct_io_flag)) {
+        printf("%s: stream mode only works with a single job, ring engine and without direct io.\n", __progname);
+        exit(-1);
+    }
+    if (verify_flag && !ENGINE_USES_RING(engine)) {
+        printf("%s: verify mode only works with ring engines.\n", __progname);
+        exit(-1);
+    }
+    // kernel engines copy in simple-cp itself, there's no put/get pair to split ranges over
+    if (!ENGINE_USES_RING(engine) && jobs != 1) {
+        printf("%s: kernel engines only work with a single job.\n", __progname);
+        exit(-1);
+    }
+    place_jobs();
+    // verify digests bytes on both sides, which is what mmap mode keeps put away from
+    if (mmap_flag && (stream_flag || transform != TRANSFORM_NONE || verify_flag || engine != ENGINE_RING)) {
+        printf("%s: mmap mode only works with a regular source file, ring engine and without stream, pipeline or verify mode.\n", __progname);
+        exit(-1);
+    }
+    if (auto_flag && (recursive_flag || transform != TRANSFORM_NONE || stream_flag || !ENGINE_USES_RING(engine))) {
+        printf("%s: auto mode only works with a regular source file, ring engines and without directory, pipeline or stream mode.\n", __progname);
+        exit(-1);
+    }
+}
+
+// pick cpu of put/gets of each job from cpu list, cpus are used in order and reused from the start if too few
+void place_jobs(void) {
+    for (int index = 0 ; index < MAX_JOBS * (MAX_CONSUMERS + 1) ; ++index) job_cpus[index] = CPU_NONE;
+    if (progress_cpu != CPU_NONE && !cpu_allowed(progress_cpu)) {
+        printf("%s: cpu %d is not available.\n", __progname, progress_cpu);
+        exit(-1);
+    }
+    if (!cpu_list) return;
+    int cpus[MAX_CPUS];
+    int count = strcmp(cpu_list, "auto") == 0 ? sibling_cpus(cpus, MAX_CPUS) : parse_cpu_list(cpu_list, cpus, MAX_CPUS);
+    if (count <= 0) {
+        printf("%s: invalid cpu list %s.\n", __progname, cpu_list);
+        exit(-1);
+    }
+    for (int index = 0 ; index < count ; ++index) {
+        if (!cpu_allowed(cpus[index])) {
+            printf("%s: cpu %d is not available.\n", __progname, cpus[index]);
+            exit(-1);
+        }
+    }
+    for (int index = 0 ; index < jobs * (consumers + 1) ; ++index) job_cpus[index] = cpus[index % count];
+    // progress thread takes a cpu left over by put/get, if any
+    if (strcmp(cpu_list, "auto") == 0 && progress_cpu == CPU_NONE && count > jobs * (consumers + 1)) progress_cpu = cpus[jobs * (consumers + 1)];
+    if (verbose_flag) for (int job = 0 ; job < jobs ; ++job) printf("%s: put/get of job %d placed on cpu %d/%d.\n", __progname, job, job_cpu(job, PRODUCER), job_cpu(job, 0));
+}
+
+// cpu of put(PRODUCER) or get of given consumer of a job
+// put of each job is followed by its gets in job_cpus, which is put/get pairs without tee mode
+int job_cpu(int job, int consumer) {
+    return job_cpus[job * (consumers + 1) + 1 + consumer];
 }
 
 // initialize procedure
 void initialize(void) {
-    // get the size of source file
+    // get the size of source file, unknown(0) if it's not a regular file
     struct stat source_file_stat;
-    if (lstat(source_file, &source_file_stat) == -1) {
-        printf("lstat failed: %s.\n", strerror(errno));
+    if (stat(source_file, &source_file_stat) == -1) {
+        printf("stat failed: %s.\n", strerror(errno));
         if (verbose_flag) printf("%s: failed to get size of input file.\n", __progname);
         exit(-1);
     }
-    source_file_size = source_file_stat.st_size;
+    source_file_size = S_ISREG(source_file_stat.st_mode) ? source_file_stat.st_size : 0;
 
-    // use ftok to create ipc_key used for interprocess communication
-    if ((ipc_key = ftok(__progname, 'c')) == -1) {
-        printf("ftok failed: %s.\n", strerror(errno));
-        if (verbose_flag) printf("%s: failed to generate IPC key.\n", __progname);
-        exit(-1);
-    }
-    if (verbose_flag) printf("%s: IPC key 0x%x generated.\n", __progname, ipc_key);
+    // mark all ipc objects as not created yet
+    for (int job = 0 ; job < jobs ; ++job) semids[job] = shmids[job] = -1;
 
-    // create semaphore set with empty slots set to buffer number
-    semid = create_semaphore_set(buffer_number);
-    if (verbose_flag) printf("%s: semaphore set created with id 0x%x.\n", __progname, semid);
-    // create ring buffer with capacity and number
-    shmid = create_ring_buffer();
-    if (verbose_flag) printf("%s: ring buffer created with id 0x%x\n", __progname, shmid);
+    create_ipc_objects();
     // set handler for SIGINT(indeed more than SIGINT needed to be handled)
     signal(SIGINT, error_handler);
+    // put/get threads exit the whole process on error, private semaphore sets must not be left behind
+    if (threads_flag) atexit(remove_semaphore_sets);
 }
 
-void process(void) {
-    // generate child processes' arguments
+// create semaphore set and ring buffer of each job with current buffer geometry
+// pages are allocated on node of the cpu first touching them, so ring buffer of a pinned job is created
+// from its put cpu, and the rest of it is touched by put/get on their own cpus
+void create_ipc_objects(void) {
+    // kernel engines need no ipc objects
+    if (!ENGINE_USES_RING(engine)) return;
+    for (int job = 0 ; job < jobs ; ++job) {
+        cpu_set_t previous;
+        pin_to_cpu(job_cpu(job, PRODUCER), &previous);
+        if (threads_flag) {
+            // threads share a private mapping, only semaphore implementation needs a(private) semaphore set
+            ipc_key = ipc_keys[job] = IPC_PRIVATE;
+            if (type == 1) semids[job] = create_semaphore_set(buffer_number);
+            private_ring_buffers[job] = create_private_ring_buffer();
+        } else {
+            // use ftok to create ipc_key used for interprocess communication
+            if ((ipc_key = ipc_keys[job] = ftok(__progname, 'c' + job)) == -1) {
+                printf("ftok failed: %s.\n", strerror(errno));
+                if (verbose_flag) printf("%s: failed to generate IPC key.\n", __progname);
+                clean_and_exit(-1);
+            }
+            if (verbose_flag) printf("%s: IPC key 0x%x generated.\n", __progname, ipc_key);
+
+            // create semaphore set with empty slots(of each consumer) set to buffer number
+            semids[job] = create_semaphore_set(buffer_number);
+            if (verbose_flag) printf("%s: semaphore set created with id 0x%x.\n", __progname, semids[job]);
+            // create ring buffer with capacity and number
+            shmids[job] = create_ring_buffer();
+            if (verbose_flag) printf("%s: ring buffer created with id 0x%x\n", __progname, shmids[job]);
+        }
+        if (job_cpu(job, PRODUCER) != CPU_NONE) restore_affinity(&previous);
+    }
+}
+
+// remove semaphore set and delete ring buffer of each job, buffer geometry must still be the one they were created with
+void delete_ipc_objects(void) {
+    if (!ENGINE_USES_RING(engine)) return;
+    for (int job = 0 ; job < jobs ; ++job) {
+        ipc_key = ipc_keys[job];
+        remove_semaphore_set(semids[job]);
+        semids[job] = -1;
+        if (threads_flag) delete_private_ring_buffer(private_ring_buffers[job]);
+        else delete_ring_buffer(shmids[job]);
+        private_ring_buffers[job] = NULL;
+        shmids[job] = -1;
+    }
+}
+
+// create dest file with the size of source file so that get processes can write their ranges
+void preallocate(const char * file) {
+    int fd = -1;
+    // truncate first, holes of source are never written by get processes in sparse copy
+    if ((fd = open(file, O_CREAT | O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR)) == -1) {
+        printf("open failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to open file %s for preallocation.\n", __progname, file);
+        clean_and_exit(-1);
+    }
+    if (ftruncate(fd, source_file_size) == -1) {
+        printf("ftruncate failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to set size of file %s.\n", __progname, file);
+        clean_and_exit(-1);
+    }
+    // allocate blocks up front, not all file systems support it so failure is not fatal
+    // sparse copy only allocates blocks of source's data extents
+    int error = 0;
+    if (!sparse_flag) {
+        error = source_file_size ? posix_fallocate(fd, 0, source_file_size) : 0;
+    } else {
+        int source_fd = open(source_file, O_RDONLY);
+        off_t data = 0, hole;
+        while (source_fd != -1 && !error && (data = lseek(source_fd, data, SEEK_DATA)) != -1 && (hole = lseek(source_fd, data, SEEK_HOLE)) != -1) {
+            error = posix_fallocate(fd, data, hole - data);
+            data = hole;
+        }
+        if (source_fd != -1) close(source_fd);
+    }
+    if (error && verbose_flag) printf("%s: failed to preallocate file %s, %s.\n", __progname, file, strerror(error));
+    close(fd);
+}
+
+// fork a child process and exec put/get process for given job and range
+// program is a path starting with "./", argv[0] of child is the name without it
+// consumer is the get's consumer of ring buffer, PRODUCER for put
+// child is pinned to cpu of its job before exec unless it's CPU_NONE
+pid_t spawn(const char * program, int job, off_t offset, off_t length, const char * file, int consumer) {
+    // generate child process's arguments
     char verbose_argument[MAX_INT_ARGUMENT_LENGTH], key_argument[MAX_INT_ARGUMENT_LENGTH];
     char capacity_argument[MAX_INT_ARGUMENT_LENGTH], number_argument[MAX_INT_ARGUMENT_LENGTH];
-    char type_argument[MAX_INT_ARGUMENT_LENGTH];
+    char type_argument[MAX_INT_ARGUMENT_LENGTH], batch_argument[MAX_INT_ARGUMENT_LENGTH];
+    char memory_argument[MAX_INT_ARGUMENT_LENGTH], huge_pages_argument[MAX_INT_ARGUMENT_LENGTH];
+    char populate_argument[MAX_INT_ARGUMENT_LENGTH];
+    char offset_argument[MAX_LONG_ARGUMENT_LENGTH], length_argument[MAX_LONG_ARGUMENT_LENGTH];
+    char engine_argument[MAX_INT_ARGUMENT_LENGTH], queue_depth_argument[MAX_INT_ARGUMENT_LENGTH];
+    char direct_io_argument[MAX_INT_ARGUMENT_LENGTH], stats_argument[MAX_INT_ARGUMENT_LENGTH];
+    char stream_argument[MAX_INT_ARGUMENT_LENGTH], verify_argument[MAX_INT_ARGUMENT_LENGTH];
+    char sparse_argument[MAX_INT_ARGUMENT_LENGTH], mmap_argument[MAX_INT_ARGUMENT_LENGTH];
+    char consumers_argument[MAX_INT_ARGUMENT_LENGTH], consumer_argument[MAX_INT_ARGUMENT_LENGTH];
     sprintf(verbose_argument,   "%d",   verbose_flag);
-    sprintf(key_argument,       "%d",   ipc_key);
+    sprintf(key_argument,       "%d",   ipc_keys[job]);
     sprintf(type_argument,      "%d",   type);
     sprintf(capacity_argument,  "%d",   buffer_capacity);
     sprintf(number_argument,    "%d",   buffer_number);
-
-    struct timespec start, end;
-    // start timing
-    clock_gettime(CLOCK_MONOTONIC, &start);
-
-    // fork two chlid processes and exec put/get processes accordingly
-    pid_t putpid, getpid;
-    if ((putpid = Fork()) == 0) {
-        execl("./simple-cp-put", "simple-cp-put", verbose_argument, key_argument, type_argument, capacity_argument, number_argument, source_file, NULL);
-        printf("excel failed: %s.\n", strerror(errno));
-        if (verbose_flag) printf("%s: failed to execute put process.\n", __progname);
-        exit(-1);
-    }
-    if (verbose_flag) printf("%s: put process created with process id %d.\n", __progname, putpid);
-    if ((getpid = Fork()) == 0) {
-        execl("./simple-cp-get", "simple-cp-get", verbose_argument, key_argument, type_argument, capacity_argument, number_argument, dest_file, NULL);
+    sprintf(batch_argument,     "%d",   batch_size);
+    sprintf(memory_argument,    "%d",   memory_backend);
+    sprintf(huge_pages_argument,"%d",   huge_pages_flag);
+    sprintf(populate_argument,  "%d",   populate_flag);
+    sprintf(offset_argument,    "%lld", (long long)offset);
+    sprintf(length_argument,    "%lld", (long long)length);
+    sprintf(engine_argument,    "%d",   engine);
+    sprintf(queue_depth_argument, "%d", queue_depth);
+    sprintf(direct_io_argument, "%d",   direct_io_flag);
+    sprintf(stats_argument,     "%d",   stats_flag);
+    sprintf(stream_argument,    "%d",   stream_flag);
+    sprintf(verify_argument,    "%d",   verify_flag);
+    sprintf(sparse_argument,    "%d",   sparse_flag);
+    sprintf(mmap_argument,      "%d",   mmap_flag);
+    sprintf(consumers_argument, "%d",   consumers);
+    sprintf(consumer_argument,  "%d",   consumer);
+
+    // memfd backend hands its descriptor to children through environment
+    export_ring_buffer(shmids[job]);
+
+    pid_t pid;
+    if ((pid = Fork()) == 0) {
+        pin_to_cpu(job_cpu(job, consumer), NULL);
+        execl(program, program + 2, verbose_argument, key_argument, type_argument, capacity_argument, number_argument, batch_argument, memory_argument, huge_pages_argument, populate_argument, offset_argument, length_argument, engine_argument, queue_depth_argument, direct_io_argument, stats_argument, stream_argument, verify_argument, sparse_argument, mmap_argument, file, source_file, consumers_argument, consumer_argument, NULL);
         printf("execl failed: %s.\n", strerror(errno));
-        if (verbose_flag) printf("%s: failed to execute get process.\n", __progname);
+        if (verbose_flag) printf("%s: failed to execute %s process.\n", __progname, program + 2);
         exit(-1);
     }
-    if (verbose_flag) printf("%s: get process created with process id %d.\n", __progname, getpid);
-    
-    // create a new thread to print progress bar
-    // ONLY shows progress bar in non-verbose mode
-    struct RingBuffer * ring_buffer = NULL;
-    pthread_t progress_thread;
-    if (!verbose_flag) {
-        // attach shared ring_buffer
-        ring_buffer = attach_ring_buffer(shmid);
-        // create thread to print progress bar
-        pthread_create(&progress_thread, NULL, print_progress, (void *)ring_buffer); 
-    }
-
-    // wait for all child processes
-    // if one child process terminated abnormally, then clean and exit
+    if (verbose_flag) printf("%s: %s process created with process id %d.\n", __progname, program + 2, pid);
+    return pid;
+}
+
+// wait for all child processes
+// if one child process terminated abnormally, then clean and exit
+void wait_children(void) {
     int status;
     pid_t pid = -1;
     while ((pid = wait(&status))) {
@@ -191,73 +542,342 @@ void process(void) {
             kill(0, SIGINT);
         }
     }
+}
+
+void * put_thread(void * argument) {
+    put_range((struct Transfer *)argument);
+    return NULL;
+}
+
+void * get_thread(void * argument) {
+    // pipeline mode, get thread is the writer of transform workers
+    if (transform != TRANSFORM_NONE) transform_range((struct Transfer *)argument, transform, workers);
+    else get_range((struct Transfer *)argument);
+    return NULL;
+}
+
+// create put/get threads for given job and range
+void start_threads(int job, off_t offset, off_t length) {
+    struct Transfer put = {private_ring_buffers[job], semids[job], source_file, offset, length};
+    struct Transfer get = {private_ring_buffers[job], semids[job], dest_file, offset, length};
+    get.source = source_file;
+    transfers[job][0] = put;
+    transfers[job][1] = get;
+    pthread_attr_t put_attribute, get_attribute;
+    pthread_attr_init(&put_attribute);
+    pthread_attr_init(&get_attribute);
+    set_thread_cpu(&put_attribute, job_cpu(job, PRODUCER));
+    set_thread_cpu(&get_attribute, job_cpu(job, 0));
+    if (pthread_create(&threads[job][0], &put_attribute, put_thread, &transfers[job][0]) != 0 ||
+        pthread_create(&threads[job][1], &get_attribute, get_thread, &transfers[job][1]) != 0) {
+        printf("pthread_create failed.\n");
+        if (verbose_flag) printf("%s: failed to create put/get threads.\n", __progname);
+        clean_and_exit(-1);
+    }
+    pthread_attr_destroy(&put_attribute);
+    pthread_attr_destroy(&get_attribute);
+    if (verbose_flag) printf("%s: put/get threads created for job %d.\n", __progname, job);
+}
+
+// wait for all put/get threads, a failed thread has already exited the process
+void wait_threads(void) {
+    for (int job = 0 ; job < jobs ; ++job) {
+        pthread_join(threads[job][0], NULL);
+        pthread_join(threads[job][1], NULL);
+    }
+    if (verbose_flag) printf("%s: all threads have finished.\n", __progname);
+}
+
+// atexit handler of threads mode
+void remove_semaphore_sets(void) {
+    for (int job = 0 ; job < jobs ; ++job) remove_semaphore_set(semids[job]);
+}
+
+// split [begin, end) into a range of each job, rounded up to buffer capacity, and start put/get of each range
+void start_jobs(off_t begin, off_t end) {
+    off_t range = (end - begin + jobs - 1) / jobs;
+    range = (range + buffer_capacity - 1) / buffer_capacity * buffer_capacity;
+    // fork two chlid processes(or create two threads) for each job and exec put/get processes accordingly
+    // tee mode forks a get process for each dest file
+    for (int job = 0 ; job < jobs ; ++job) {
+        off_t offset = begin + range * job < end ? begin + range * job : end;
+        off_t length = offset + range < end ? range : end - offset;
+        if (threads_flag) {
+            start_threads(job, offset, length);
+        } else {
+            spawn("./simple-cp-put", job, offset, length, source_file, PRODUCER);
+            for (int consumer = 0 ; consumer < consumers ; ++consumer) spawn("./simple-cp-get", job, offset, length, dest_files[consumer], consumer);
+        }
+    }
+}
+
+// wait for put/get processes(threads) of all jobs
+void wait_jobs(void) {
+    threads_flag ? wait_threads() : wait_children();
+}
+
+// ring buffer of given job for reading its counters, shared ones are attached and must be deattached
+struct RingBuffer * job_ring_buffer(int job) {
+    return threads_flag ? private_ring_buffers[job] : attach_ring_buffer(shmids[job]);
+}
+
+// auto mode, copy first ranges of source with each candidate geometry in turn and keep the fastest one
+// ring buffer is re-created between ranges, put/get have finished with a range and its ring buffer
+// by then, so no slot is in flight when geometry changes
+// returns where the rest of source starts
+off_t auto_tune(void) {
+    int capacities[AUTO_CANDIDATES];
+    int candidates = auto_candidates(buffer_capacity, capacities);
+    int minimum = batch_size > queue_depth ? batch_size : queue_depth; // slots are never fewer than batch size or queue depth
+    // probing a small file costs more than it saves, first guess is kept
+    if (source_file_size < (off_t)candidates * AUTO_PROBE_SIZE * AUTO_PROBE_RATIO) return 0;
+
+    // probes are single ranges with a single pair
+    delete_ipc_objects();
+    int requested_jobs = jobs;
+    jobs = 1;
+    off_t offset = 0;
+    int best = 0;
+    double best_speed = 0;
+    for (int candidate = 0 ; candidate < candidates ; ++candidate) {
+        buffer_capacity = capacities[candidate];
+        buffer_number = auto_number(buffer_capacity, minimum);
+        create_ipc_objects();
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        start_jobs(offset, offset + AUTO_PROBE_SIZE);
+        wait_jobs();
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double duration = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+
+        // holes cost nothing, only bytes actually copied are counted
+        struct RingBuffer * ring_buffer = job_ring_buffer(0);
+        size_t transferred = number_of_bytes_transferred(ring_buffer);
+        probe_skipped_size += number_of_bytes_skipped(ring_buffer);
+        if (verify_flag) {
+            probe_source_digest = crc32c_combine(probe_source_digest, ring_buffer->source_digest, ring_buffer->source_size);
+            probe_dest_digest = crc32c_combine(probe_dest_digest, ring_buffer->consumer[0].dest_digest, transferred);
+        }
+        if (!threads_flag) deattach_ring_buffer(ring_buffer);
+        delete_ipc_objects();
+
+        double speed = transferred / duration;
+        if (verbose_flag) printf("%s: buffer capacity %d and buffer number %d copied %zu bytes at %.3f MB/s.\n", __progname, buffer_capacity, buffer_number, transferred, speed / 1024 / 1024);
+        if (speed > best_speed) {
+            best = candidate;
+            best_speed = speed;
+        }
+        offset += AUTO_PROBE_SIZE;
+    }
+
+    // rest of source is copied by all jobs with the fastest geometry
+    jobs = requested_jobs;
+    buffer_capacity = capacities[best];
+    buffer_number = auto_number(buffer_capacity, minimum);
+    create_ipc_objects();
+    return offset;
+}
+
+// copy with kernel engine in current process, skipping ring buffer
+void copy_in_kernel(void) {
+    int in_fd = -1, out_fd = -1;
+    if ((in_fd = open(source_file, O_RDONLY)) == -1) {
+        printf("open failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to open file %s for reading.\n", __progname, source_file);
+        exit(-1);
+    }
+    if ((out_fd = open(dest_file, O_CREAT | O_WRONLY | O_TRUNC, S_IRUSR | S_IWUSR)) == -1) {
+        printf("open failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to open file %s for writing.\n", __progname, dest_file);
+        exit(-1);
+    }
+    kernel_copy(in_fd, out_fd, source_file_size, engine, &kernel_transferred_size);
+    close(in_fd);
+    close(out_fd);
+}
 
-    if (!verbose_flag) {
-        // wait for the progress thread to join
-        pthread_join(progress_thread, NULL);
-        // deattach shared ring_buffer
-        deattach_ring_buffer(ring_buffer);
+// combine digests of all jobs in range order and compare source with dest, each dest in tee mode
+// each job's digest covers its own range, so they are chained as if one pass went over the whole file
+// returns 1 if digests match
+int verify(struct RingBuffer ** ring_buffers) {
+    // ranges copied by probes of auto mode come first
+    uint32_t source_digest = probe_source_digest;
+    for (int job = 0 ; job < jobs ; ++job) source_digest = crc32c_combine(source_digest, ring_buffers[job]->source_digest, ring_buffers[job]->source_size);
+    int matched = 1;
+    for (int consumer = 0 ; consumer < consumers ; ++consumer) {
+        uint32_t dest_digest = probe_dest_digest;
+        for (int job = 0 ; job < jobs ; ++job) {
+            struct RingBufferConsumer * line = &ring_buffers[job]->consumer[consumer];
+            dest_digest = crc32c_combine(dest_digest, line->dest_digest, line->total_size);
+        }
+        printf("source crc32c 0x%08x, dest crc32c 0x%08x", source_digest, dest_digest);
+        if (consumers > 1) printf(" of %s", dest_files[consumer]);
+        printf(", %s.\n", source_digest == dest_digest ? "verified" : "MISMATCH");
+        if (source_digest != dest_digest) matched = 0;
     }
+    return matched;
+}
+
+void process(void) {
+    // dest file must exist with its final size before get processes write ranges into it
+    // stream mode has a single range of unknown size, get process creates dest file itself
+    // so does pipeline mode, whose dest size isn't known before transform, and directory mode
+    if (ENGINE_USES_RING(engine) && !stream_flag && transform == TRANSFORM_NONE && !recursive_flag) {
+        for (int consumer = 0 ; consumer < consumers ; ++consumer) preallocate(dest_files[consumer]);
+    }
+
+    struct timespec start, end;
+    // start timing
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // directory mode, walk the tree first so that progress bar knows total size
+    if (recursive_flag) source_file_size = walk_directory(source_file, dest_file);
+
+    // auto mode has copied first ranges of source while choosing geometry, progress bar counts them as done
+    off_t begin = auto_flag ? auto_tune() : 0;
+    kernel_transferred_size += begin;
+    if (auto_flag) printf("buffer capacity tuned to %d and buffer number tuned to %d.\n", buffer_capacity, buffer_number);
+
+    // directory mode creates its own put/get threads, one pair for all files of each job
+    if (!recursive_flag && ENGINE_USES_RING(engine)) start_jobs(begin, source_file_size);
+
+    // start progress bar
+    // ONLY shows progress bar in non-verbose mode and when stdout is a terminal(not redirected by benchmark or scripts)
+    int progress_flag = !verbose_flag && isatty(STDOUT_FILENO);
+    struct RingBuffer * ring_buffers[MAX_JOBS];
+    // attach shared ring_buffers for progress bar, statistics, digests, holes skipped and bytes transferred in stream mode
+    // threads mode uses private ring buffers directly, kernel engines have none and only count kernel_transferred_size
+    int attach_flag = ENGINE_USES_RING(engine) && (progress_flag || stats_flag || stream_flag || verify_flag || sparse_flag);
+    if (attach_flag) for (int job = 0 ; job < jobs ; ++job) ring_buffers[job] = job_ring_buffer(job);
+    if (progress_flag) start_progress(dest_file, source_file_size, ring_buffers, attach_flag ? jobs : 0, &kernel_transferred_size, progress_cpu);
+
+    // ring engine waits for put/get processes(threads), kernel engines copy in current process
+    if (recursive_flag) copy_files(private_ring_buffers, semids, jobs, job_cpus);
+    else if (ENGINE_USES_RING(engine)) wait_jobs();
+    else copy_in_kernel();
+
+    // draw final progress bar and stop its thread
+    if (progress_flag) stop_progress();
+
+    // modes and mtimes of all files and directories in one go
+    if (recursive_flag) apply_metadata();
 
     //end timing
     clock_gettime(CLOCK_MONOTONIC, &end);
     double duration = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
-    printf("%lu bytes data transferred in %.3f seconds, speed is %.3f MB/s.\n", source_file_size, duration, source_file_size / duration / 1024 / 1024);
+    // size of source isn't known in stream mode, count what get processes have written
+    size_t transferred_size = source_file_size;
+    if (stream_flag) {
+        transferred_size = 0;
+        for (int job = 0 ; job < jobs ; ++job) transferred_size += number_of_bytes_transferred(ring_buffers[job]);
+    }
+    // holes are skipped rather than copied, speed only counts data bytes
+    size_t skipped_size = probe_skipped_size;
+    if (sparse_flag && attach_flag) for (int job = 0 ; job < jobs ; ++job) skipped_size += number_of_bytes_skipped(ring_buffers[job]);
+    if (skipped_size > transferred_size) skipped_size = transferred_size;
+    size_t data_size = transferred_size - skipped_size;
+    printf("%lu bytes data transferred in %.3f seconds, speed is %.3f MB/s.\n", data_size, duration, data_size / duration / 1024 / 1024);
+    if (skipped_size) printf("%zu bytes of holes skipped.\n", skipped_size);
+    if (recursive_flag) printf("%zu files in %zu directories copied, %.1f files/s.\n", number_of_files(), number_of_directories(), number_of_files() / duration);
+    if (transform != TRANSFORM_NONE) printf("%zu bytes written to dest after %s.\n", transfers[0][1].size, transform_name(transform));
+
+    // put/get processes have exited, their statistics are complete
+    if (stats_flag && attach_flag) for (int job = 0 ; job < jobs ; ++job) print_ring_buffer_stats(ring_buffers[job], job);
+    int verified = verify_flag ? verify(ring_buffers) : 1;
+
+    // deattach shared ring_buffers
+    if (attach_flag && !threads_flag) for (int job = 0 ; job < jobs ; ++job) deattach_ring_buffer(ring_buffers[job]);
+
+    // dest is not what was read from source
+    if (!verified) clean_and_exit(-1);
 }
 
-void error_handler(int sig) {
-    // only catch SIGINT so no neet for volatile sig_atomic_t flag
-    // clean up
-    remove_semaphore_set(semid);
-    delete_ring_buffer(shmid);
-    // reactive signal to set right return status
-    signal(sig, SIG_DFL);
-    raise(sig);
+// path as seen from any working directory, server doesn't share ours
+char * absolute_path(const char * path) {
+    if (path[0] == '/') return strdup(path);
+    char * directory = getcwd(NULL, 0);
+    if (directory == NULL) {
+        printf("getcwd failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to get working directory.\n", __progname);
+        exit(-1);
+    }
+    char * absolute = malloc(strlen(directory) + strlen(path) + 2);
+    sprintf(absolute, "%s/%s", directory, path);
+    free(directory);
+    return absolute;
 }
 
-void * print_progress(void * argument) {
-    // acquire shared ring buffer from argument
-    struct RingBuffer * ring_buffer = (struct RingBuffer *)argument;
-
-    size_t transferred_size; // transferred file size
-    double percent; // complete percentage
-
-    struct winsize window_size; // window size (contains rows and columns)
-    int columns; // columns number excluding file name and []
-    int dest_file_name_length = strlen(dest_file); // file name length
-
-    while (transferred_size < source_file_size) {
-        // acquire transferred bytes from shared ring buffer
-        // and calculate complete percentage
-        transferred_size = number_of_bytes_transferred(ring_buffer);
-        percent = (double)transferred_size / source_file_size;
-        
-        // use ioctl to acquire console window's size
-        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &window_size) == -1) {
-            printf("ioctl failed: %s.\n", strerror(errno));
-            if (verbose_flag) printf("%s: failed to get console window's size.\n", __progname);
+// submit copy to simple-cp-server and follow its progress instead of copying in this process
+void submit_job(void) {
+    if (consumers > 1) {
+        printf("%s: server copies to a single dest file.\n", __progname);
+        exit(-1);
+    }
+    char * source = absolute_path(source_file), * dest = absolute_path(dest_file);
+    size_t source_length = strlen(source) + 1, dest_length = strlen(dest) + 1;
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (source_length + dest_length > MAX_REQUEST_LENGTH || strlen(server_socket) >= sizeof(address.sun_path)) {
+        printf("%s: paths are too long.\n", __progname);
+        exit(-1);
+    }
+    strcpy(address.sun_path, server_socket);
+
+    char request[MAX_REQUEST_LENGTH];
+    memcpy(request, source, source_length);
+    memcpy(request + source_length, dest, dest_length);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1 || connect(fd, (struct sockaddr *)&address, sizeof(address)) == -1) {
+        printf("connect failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to connect to server %s.\n", __progname, server_socket);
+        exit(-1);
+    }
+    if (send(fd, request, source_length + dest_length, MSG_NOSIGNAL) != (ssize_t)(source_length + dest_length)) {
+        printf("send failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to submit copy to server.\n", __progname);
+        exit(-1);
+    }
+    if (verbose_flag) printf("%s: copy of %s to %s submitted to server %s.\n", __progname, source, dest, server_socket);
+
+    // ONLY shows progress in non-verbose mode and when stdout is a terminal, same as local copies
+    int progress_flag = !verbose_flag && isatty(STDOUT_FILENO);
+    FILE * stream = fdopen(fd, "r");
+    char line[MAX_MESSAGE_LENGTH];
+    while (fgets(line, sizeof(line), stream)) {
+        long long done, total;
+        double duration;
+        if (sscanf(line, "progress %lld %lld", &done, &total) == 2) {
+            if (progress_flag) printf("\r%3lld%% %s", done * 100 / total, dest_file);
+            if (verbose_flag) printf("%s: %lld of %lld bytes copied.\n", __progname, done, total);
+            fflush(stdout);
+        } else if (sscanf(line, "done %lld %lf", &done, &duration) == 2) {
+            if (progress_flag) printf("\r100%% %s\n", dest_file);
+            printf("%lld bytes data transferred in %.3f seconds, speed is %.3f MB/s.\n", done, duration, done / duration / 1024 / 1024);
+            exit(0);
+        } else if (strncmp(line, "error ", strlen("error ")) == 0) {
+            if (progress_flag) putchar('\n');
+            printf("%s: %s", __progname, line + strlen("error "));
             exit(-1);
         }
-        // calculate columns accordingly
-        columns = window_size.ws_col - dest_file_name_length - 4; // 3 = 1 space + 1 [ + 1 ] + 1 preserved
-
-        putchar('\r'); // move to the first of line
-        printf("%s :", dest_file); // print file name
-
-        putchar('['); // print [
-        for (int count = 0 ; count < columns ; ++count) {
-            // print # or space
-            char out_char = (count < columns * percent) ? '#' : ' ';
-            putchar(out_char);
-        }
-        putchar(']'); // print ]
+    }
+    printf("%s: server closed connection before copy finished.\n", __progname);
+    exit(-1);
+}
 
-        fflush(stdout); // flush stdout explictly
-    
-        usleep(REFRESH_TIME_INTERVAL); // micro-second sleep
+void error_handler(int sig) {
+    // only catch SIGINT so no neet for volatile sig_atomic_t flag
+    // clean up, kernel engines have nothing to clean
+    for (int job = 0 ; ENGINE_USES_RING(engine) && job < jobs ; ++job) {
+        ipc_key = ipc_keys[job];
+        remove_semaphore_set(semids[job]);
+        if (!threads_flag) delete_ring_buffer(shmids[job]);
     }
-    return NULL;
-}       
+    // reactive signal to set right return status
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
 
 // program entry
 int main(int argc, char * argv[]) {
@@ -268,16 +888,58 @@ int main(int argc, char * argv[]) {
         {"type",            1,  NULL,   't'},
         {"buffer-capacity", 1,  NULL,   1},
         {"buffer-number",   1,  NULL,   2},
+        {"batch-size",      1,  NULL,   3},
+        {"memory",          1,  NULL,   4},
+        {"huge-pages",      0,  NULL,   5},
+        {"populate",        0,  NULL,   6},
+        {"jobs",            1,  NULL,   'j'},
+        {"recursive",       0,  NULL,   'r'},
+        {"engine",          1,  NULL,   7},
+        {"queue-depth",     1,  NULL,   8},
+        {"direct",          0,  NULL,   9},
+        {"stats",           0,  NULL,   10},
+        {"threads",         0,  NULL,   11},
+        {"stream",          0,  NULL,   12},
+        {"verify",          0,  NULL,   13},
+        {"no-sparse",       0,  NULL,   16},
+        {"transform",       1,  NULL,   14},
+        {"workers",         1,  NULL,   15},
+        {"auto",            0,  NULL,   17},
+        {"cpus",            1,  NULL,   18},
+        {"progress-cpu",    1,  NULL,   19},
+        {"server",          1,  NULL,   20},
+        {"mmap",            0,  NULL,   21},
         {0,                 0,  0,      0}
     };
     // parse command line options
     int opt;
-    while ((opt = getopt_long(argc, argv, "hvt:", options, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "hvt:j:r", options, NULL)) != -1) {
         switch (opt) {
             case 'v':   verbose_flag = 1;                   break;
             case 't':   type = atoi(optarg);                break;
+            case 'j':   jobs = atoi(optarg);                break;
+            case 'r':   recursive_flag = 1;                 break;
             case 1:     buffer_capacity = atoi(optarg);     break;
             case 2:     buffer_number = atoi(optarg);       break;
+            case 3:     batch_size = atoi(optarg);          break;
+            case 4:     memory_backend = parse_memory_backend(optarg); break;
+            case 5:     huge_pages_flag = 1;                break;
+            case 6:     populate_flag = 1;                  break;
+            case 7:     engine = parse_engine(optarg);      break;
+            case 8:     queue_depth = atoi(optarg);         break;
+            case 9:     direct_io_flag = 1;                 break;
+            case 10:    stats_flag = 1;                     break;
+            case 11:    threads_flag = 1;                   break;
+            case 12:    stream_flag = 1;                    break;
+            case 13:    verify_flag = 1;                    break;
+            case 14:    transform = parse_transform(optarg); break;
+            case 15:    workers = atoi(optarg);             break;
+            case 16:    sparse_flag = 0;                    break;
+            case 17:    auto_flag = 1;                      break;
+            case 18:    cpu_list = optarg;                  break;
+            case 19:    progress_cpu = atoi(optarg);        break;
+            case 20:    server_socket = optarg;             break;
+            case 21:    mmap_flag = 1;                      break;
             case 'h':   help(0);                            break;
             case '?':   help(-1);                           break;
         }
@@ -289,6 +951,16 @@ int main(int argc, char * argv[]) {
     }
     source_file = argv[optind];
     dest_file   = argv[optind + 1];
+    // more dest files make a tee copy
+    consumers = argc - optind - 1;
+    if (consumers > MAX_CONSUMERS) {
+        printf("%s: at most %d dest files expected.\n", argv[0], MAX_CONSUMERS);
+        exit(-1);
+    }
+    for (int consumer = 0 ; consumer < consumers ; ++consumer) dest_files[consumer] = argv[optind + 1 + consumer];
+
+    // server does its own validation and copies with its own pool
+    if (server_socket) submit_job();
 
     // validation
     if (verbose_flag) printf("%s: starting validation process...\n", argv[0]);
@@ -0,0 +1,815 @@
+// O_DIRECT needs gnu extensions
+#define _GNU_SOURCE
+
+// include system headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+// include user headers
+#include "semaphore.h"
+#include "kernel-copy.h"
+#include "uring.h"
+#include "crc32c.h"
+#include "transform.h"
+
+// include own header
+#include "transfer.h"
+
+extern const char * __progname; // gcc defined as substitute for argv[0]
+
+extern int verbose_flag; // verbose flag
+
+extern int type; // implementation type
+extern int buffer_capacity; // buffer capacity
+extern int buffer_number; // buffer number
+extern int batch_size; // slots acquired per semaphore operation
+extern int direct_io_flag; // direct io flag
+extern int stats_flag; // stats flag
+extern int engine, queue_depth; // ring or io_uring engine and io_uring queue depth
+extern int stream_flag; // stream flag
+extern int verify_flag; // verify flag
+extern int sparse_flag; // sparse flag
+extern int mmap_flag; // mmap flag
+
+#define STREAM_MAX_RECORDS 64 // max stream records drained by one write
+#define MAPPED_EXTENT_SIZE (4 << 20) // longest extent of a slot in mmap mode, written by get at once
+
+// transformed slot waiting for writer, indexed by sequence number % buffer number
+struct TransformedSlot {
+    char * bytes; // transformed bytes
+    size_t size; // transformed size
+    size_t sequence; // sequence number of ring buffer slot it was transformed from
+    int ready; // transformed and not written yet
+    int end_of_file; // transformed from the empty slot
+};
+
+// state shared by workers and writer of pipeline mode
+// slots of ring buffer are claimed by workers in order and numbered by sequence, a worker only
+// writes to the transformed slot of its own sequence and writer only takes them in sequence,
+// so a slow worker delays output but never reorders it
+// ring buffer slots are released in sequence as well, so there are never more than buffer number
+// sequences in flight and transformed slot of a sequence is free once writer has got that far
+// a worker never waits for ring buffer while claimed slots are still held back, put may be waiting
+// for them and the worker holding them needs input mutex to release them
+struct Pipeline {
+    struct Transfer * transfer;
+    int transform;
+    pthread_mutex_t input_mutex; // workers take turns as consumer of ring buffer
+    size_t claimed, released; // ring buffer slots claimed and released so far
+    int * done; // transformed flags of claimed slots, indexed by sequence % buffer number
+    int end_of_file; // empty slot claimed, nothing left to claim
+    pthread_cond_t input_transformed; // workers wait for claimed slots to be transformed and released
+    pthread_mutex_t output_mutex; // protects ready/sequence/end_of_file of transformed slots
+    pthread_cond_t output_ready; // writer waits for next sequence
+    pthread_cond_t output_free; // workers wait for their transformed slot to be written
+    struct TransformedSlot * slots;
+};
+
+// private function list, all wrapper functions
+ssize_t Pread(int fildes, void * buf, size_t nbyte, off_t offset);
+ssize_t Pwrite(int fildes, const void * buf, size_t nbyte, off_t offset);
+ssize_t Readv(int fildes, const struct iovec * iov, int iovcnt);
+size_t Writev(int fildes, struct iovec * iov, int iovcnt);
+int Open(const char * file, int flags);
+
+// private function list, put helpers
+size_t align_to_slot(size_t size);
+off_t next_extent(int fd, off_t offset, off_t end, off_t * extent_end);
+void check_source_end(off_t offset, off_t end);
+int acquire_empty_slots(struct RingBuffer * ring_buffer, int semid, int batch);
+void put_synchronously(struct Transfer * transfer, int fd);
+void put_with_uring(struct Transfer * transfer, int fd);
+void put_extents(struct Transfer * transfer, int fd);
+
+// private function list, get helpers
+void skip_hole(struct Transfer * transfer, off_t offset, off_t end);
+int acquire_full_slots(struct RingBuffer * ring_buffer, int semid, int batch);
+void get_synchronously(struct Transfer * transfer, int fd, int tail_fd);
+void get_with_uring(struct Transfer * transfer, int fd, int tail_fd);
+void get_extents(struct Transfer * transfer, int fd, int tail_fd);
+
+// private function list, verify helpers
+void digest_bytes(struct Transfer * transfer, const void * bytes, size_t size);
+void digest_pieces(struct Transfer * transfer, const struct iovec * pieces, int count, size_t size);
+
+// private function list, pipeline helpers
+void * transform_worker(void * argument);
+
+// private function list, stream helpers
+void put_stream(struct Transfer * transfer, int fd);
+void get_stream(struct Transfer * transfer, int fd);
+
+// pread wrapper
+ssize_t Pread(int fildes, void * buf, size_t nbyte, off_t offset) {
+    ssize_t result = -1;
+    if ((result = pread(fildes, buf, nbyte, offset)) == -1) {
+        printf("read failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to read from source file.\n", __progname);
+        exit(-1);
+    }
+    return result;
+}
+
+// add bytes to digest of transfer, called right after read/before write while they are in cache
+void digest_bytes(struct Transfer * transfer, const void * bytes, size_t size) {
+    transfer->digest = crc32c_update(transfer->digest, bytes, size);
+    transfer->size += size;
+}
+
+// add first size bytes of pieces to digest of transfer
+void digest_pieces(struct Transfer * transfer, const struct iovec * pieces, int count, size_t size) {
+    for (int index = 0 ; index < count && size > 0 ; ++index) {
+        size_t piece = pieces[index].iov_len < size ? pieces[index].iov_len : size;
+        digest_bytes(transfer, pieces[index].iov_base, piece);
+        size -= piece;
+    }
+}
+
+// put bytes to shared ring buffer, one read at a time
+// round read length up to slot alignment, O_DIRECT rejects unaligned lengths
+// slot bytes are always large enough since buffer capacity is page aligned in direct io mode
+size_t align_to_slot(size_t size) {
+    size_t alignment = slot_alignment();
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+// find next data extent of source at or after offset, returns its start and sets extent_end to its end
+// both are clamped to end of range, a range with no data left returns end
+// sparse copy only, otherwise the rest of range is one extent
+// direct io mode, extents are widened to slot alignment, O_DIRECT rejects unaligned offsets
+off_t next_extent(int fd, off_t offset, off_t end, off_t * extent_end) {
+    *extent_end = end;
+    if (!sparse_flag || offset >= end) return offset;
+    off_t data = lseek(fd, offset, SEEK_DATA), hole;
+    if (data == -1 && errno == ENXIO) return end; // only hole left up to end of file
+    if (data == -1 || (hole = lseek(fd, data, SEEK_HOLE)) == -1) {
+        printf("lseek failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to find data extents of source file.\n", __progname);
+        exit(-1);
+    }
+    if (direct_io_flag) {
+        data = data / slot_alignment() * slot_alignment();
+        hole = align_to_slot(hole);
+    }
+    if (data < offset) data = offset;
+    if (data > end) data = end;
+    if (hole < end) *extent_end = hole;
+    return data;
+}
+
+// end of file at offset before end of range, source file shrank since its size was taken
+// a copy missing its tail must not look like a complete one
+void check_source_end(off_t offset, off_t end) {
+    if (offset < end) {
+        printf("%s: source file shrank to %ld bytes while copying.\n", __progname, (long)offset);
+        exit(-1);
+    }
+}
+
+// acquire up to batch empty slots with semaphore, returns the number of slots acquired
+// stats mode, record a stall if no empty slot is left before acquiring
+int acquire_empty_slots(struct RingBuffer * ring_buffer, int semid, int batch) {
+    struct timespec start;
+    int stalled = stats_flag && number_of_empty_slots(ring_buffer) == 0;
+    if (stalled) start_stats_clock(&start);
+    int slots = 1;
+    if (batch == 1) semaphore_p(semid, EMPTY_SLOTS); // empty slots minus 1
+    else slots = semaphore_p_batch(semid, EMPTY_SLOTS, batch); // empty slots minus slots
+    if (stalled) record_stall(&ring_buffer->producer_stats, &start);
+    return slots;
+}
+
+void put_synchronously(struct Transfer * transfer, int fd) {
+    struct RingBuffer * ring_buffer = transfer->ring_buffer;
+    int semid = transfer->semid;
+    off_t offset = transfer->offset, end = transfer->offset + transfer->length;
+    off_t extent_end = offset; // end of data extent being read, hole after it is skipped
+    int byte_count; // byte number that read from file
+    char * bytes; // bytes of reserved buffer entry
+    int end_of_file_flag = 0; // mark end of file
+    int slots, filled; // slots acquired and filled in current batch
+    struct timespec start; // start of read in stats mode
+    do {
+        slots = 1;
+        // version 1 & 2 - (mutex)/semaphores implementation
+        if (type == 1) slots = acquire_empty_slots(ring_buffer, semid, batch_size);
+        // semaphore_p(semid, MUTEX_LOCK); // mutex lock acquired
+        for (filled = 0 ; filled < slots && !end_of_file_flag ; ++filled) {
+            // read from file straight into shared memory buffer, stop at the end of range
+            bytes = reserve_write_slot(ring_buffer);
+            // jump over hole once current data extent has been read
+            if (offset == extent_end) offset = next_extent(fd, offset, end, &extent_end);
+            // O_DIRECT reads whole aligned blocks, never keep more than the extent
+            int wanted = extent_end - offset < buffer_capacity ? extent_end - offset : buffer_capacity;
+            if (stats_flag) start_stats_clock(&start);
+            if ((byte_count = Pread(fd, bytes, align_to_slot(wanted), offset)) == 0) {
+                check_source_end(offset, end);
+                end_of_file_flag = 1;
+            }
+            if (stats_flag) record_latency(&ring_buffer->producer_stats, &start);
+            if (byte_count > wanted) byte_count = wanted;
+            if (verbose_flag) printf("%s: %d bytes read from file.\n", __progname, byte_count);
+            if (verify_flag) digest_bytes(transfer, bytes, byte_count);
+            commit_write_extent(ring_buffer, byte_count, offset);
+            offset += byte_count;
+        }
+        // semaphore_v(semid, MUTEX_LOCK); // mutex lock released
+        // unnecessary for mutex, cuz single producer and single consumer won't read / write
+        // same buffer at the same time
+        if (type == 1) semaphore_v_batch(semid, FULL_SLOTS, filled); // full slots add filled
+        // slots acquired after end of file go back, ring buffer may be reused for another file
+        if (type == 1) semaphore_v_batch(semid, EMPTY_SLOTS, slots - filled);
+
+    } while (!end_of_file_flag);
+}
+
+// put bytes to shared ring buffer with io_uring
+// keep queue_depth reads in flight directly into reserved slots, reads may complete
+// out of order but slots are only committed in order once they have completed
+// a new slot is only waited for when no reserved slot is left uncommitted, otherwise
+// put could sleep on a full ring buffer while get waits for those very slots
+void put_with_uring(struct Transfer * transfer, int fd) {
+    struct RingBuffer * ring_buffer = transfer->ring_buffer;
+    int semid = transfer->semid;
+    off_t offset = transfer->offset, end = transfer->offset + transfer->length;
+    off_t extent_end = offset; // end of data extent being read, hole after it is skipped
+    struct Uring uring;
+    uring_init(&uring, queue_depth);
+
+    char * buffers[queue_depth]; // bytes of each in-flight slot
+    off_t offsets[queue_depth]; // file offset of each in-flight slot
+    int wanted[queue_depth], sizes[queue_depth]; // bytes wanted and read of each in-flight slot
+    int completed[queue_depth]; // whether read of each in-flight slot has completed
+    struct timespec starts[queue_depth]; // start of read of each in-flight slot in stats mode
+    size_t reserved = 0, committed = 0; // slots reserved and committed so far
+    int end_of_file_flag = 0; // mark end of file slot reserved
+    int committed_end_flag = 0; // mark end of file slot committed
+    unsigned long long slot; // slot number of a completion
+    int result, index; // result of a completion and index of its slot
+    while (!committed_end_flag) {
+        // keep queue full, stop at the end of range
+        while (!end_of_file_flag && reserved - committed < queue_depth && (reserved == committed || number_of_empty_slots(ring_buffer) > 0)) {
+            if (type == 1) acquire_empty_slots(ring_buffer, semid, 1);
+            index = reserved % queue_depth;
+            buffers[index] = reserve_write_slot(ring_buffer);
+            // jump over hole once current data extent has been read
+            if (offset == extent_end) offset = next_extent(fd, offset, end, &extent_end);
+            offsets[index] = offset;
+            wanted[index] = extent_end - offset < buffer_capacity ? extent_end - offset : buffer_capacity;
+            sizes[index] = completed[index] = 0;
+            if (wanted[index] == 0) {
+                // nothing left to read, end of file slot completes immediately
+                completed[index] = 1;
+                end_of_file_flag = 1;
+            } else {
+                if (stats_flag) start_stats_clock(&starts[index]);
+                uring_prepare(&uring, IORING_OP_READ, fd, buffers[index], align_to_slot(wanted[index]), offset, reserved);
+                offset += wanted[index];
+            }
+            ++reserved;
+        }
+        // submit and wait only if the oldest slot hasn't completed yet
+        uring_submit(&uring, completed[committed % queue_depth] ? 0 : 1);
+        while (uring_complete(&uring, &slot, &result)) {
+            if (result < 0) {
+                printf("read failed: %s.\n", strerror(-result));
+                if (verbose_flag) printf("%s: failed to read from file %s.\n", __progname, transfer->file);
+                exit(-1);
+            }
+            index = slot % queue_depth;
+            sizes[index] += result;
+            if (sizes[index] > wanted[index]) sizes[index] = wanted[index]; // O_DIRECT reads whole aligned blocks
+            if (verbose_flag) printf("%s: %d bytes read from file.\n", __progname, result);
+            if (result == 0 && sizes[index] < wanted[index]) check_source_end(offsets[index] + sizes[index], end);
+            // short read, read the rest of slot unless end of file is reached
+            if (result > 0 && sizes[index] < wanted[index]) {
+                uring_prepare(&uring, IORING_OP_READ, fd, buffers[index] + sizes[index], align_to_slot(wanted[index] - sizes[index]), offsets[index] + sizes[index], slot);
+            } else {
+                completed[index] = 1;
+                if (stats_flag) record_latency(&ring_buffer->producer_stats, &starts[index]);
+            }
+        }
+        // commit completed slots in order
+        int filled = 0;
+        while (committed < reserved && completed[committed % queue_depth]) {
+            index = committed % queue_depth;
+            if (sizes[index] == 0) committed_end_flag = 1;
+            if (verify_flag) digest_bytes(transfer, buffers[index], sizes[index]);
+            commit_write_extent(ring_buffer, sizes[index], offsets[index]);
+            ++committed;
+            ++filled;
+        }
+        if (type == 1) semaphore_v_batch(semid, FULL_SLOTS, filled); // full slots add filled
+    }
+
+    uring_exit(&uring);
+}
+
+// put extents of source to shared ring buffer, bytes are left to get's mapping of source
+// a slot carries no bytes, so an extent may be much longer than buffer capacity, readahead of
+// each extent is started as it's published so that get seldom faults on a page not yet read
+void put_extents(struct Transfer * transfer, int fd) {
+    struct RingBuffer * ring_buffer = transfer->ring_buffer;
+    int semid = transfer->semid;
+    off_t offset = transfer->offset, end = transfer->offset + transfer->length;
+    off_t extent_end = offset; // end of data extent being put, hole after it is skipped
+    int size; // bytes of extent of a slot
+    int end_of_file_flag = 0; // mark end of file
+    int slots, filled; // slots acquired and filled in current batch
+    struct stat source_stat; // size of source before an extent is put
+    posix_fadvise(fd, transfer->offset, transfer->length, POSIX_FADV_SEQUENTIAL);
+    do {
+        slots = 1;
+        if (type == 1) slots = acquire_empty_slots(ring_buffer, semid, batch_size);
+        for (filled = 0 ; filled < slots && !end_of_file_flag ; ++filled) {
+            reserve_write_slot(ring_buffer);
+            // jump over hole once current data extent has been put
+            if (offset == extent_end) offset = next_extent(fd, offset, end, &extent_end);
+            size = extent_end - offset < MAPPED_EXTENT_SIZE ? extent_end - offset : MAPPED_EXTENT_SIZE;
+            // get maps source, an extent past its end would fault there instead of failing here
+            if (size && fstat(fd, &source_stat) == 0 && source_stat.st_size < offset + size) check_source_end(source_stat.st_size, end);
+            if (size == 0) end_of_file_flag = 1;
+            else posix_fadvise(fd, offset, size, POSIX_FADV_WILLNEED);
+            if (verbose_flag) printf("%s: extent of %d bytes at %lld put.\n", __progname, size, (long long)offset);
+            commit_write_extent(ring_buffer, size, offset);
+            offset += size;
+        }
+        if (type == 1) semaphore_v_batch(semid, FULL_SLOTS, filled); // full slots add filled
+        // slots acquired after end of file go back, ring buffer may be reused for another file
+        if (type == 1) semaphore_v_batch(semid, EMPTY_SLOTS, slots - filled);
+    } while (!end_of_file_flag);
+}
+
+// pwrite wrapper, writes the rest after a short write and retries when interrupted
+// returns the number of bytes written, which is always nbyte
+ssize_t Pwrite(int fildes, const void * buf, size_t nbyte, off_t offset) {
+    size_t total = 0;
+    while (total < nbyte) {
+        ssize_t result = pwrite(fildes, (const char *)buf + total, nbyte - total, offset + total);
+        if (result == -1 && errno == EINTR) continue;
+        if (result <= 0) {
+            printf("write failed: %s.\n", result == -1 ? strerror(errno) : "nothing written");
+            if (verbose_flag) printf("%s: failed to write to dest file.\n", __progname);
+            exit(-1);
+        }
+        total += result;
+    }
+    return total;
+}
+
+// acquire up to batch full slots with semaphore, returns the number of slots acquired
+// stats mode, record a stall if no full slot is left before acquiring
+int acquire_full_slots(struct RingBuffer * ring_buffer, int semid, int batch) {
+    struct timespec start;
+    int stalled = stats_flag && number_of_full_slots(ring_buffer) == 0;
+    if (stalled) start_stats_clock(&start);
+    int slots = 1;
+    if (batch == 1) semaphore_p(semid, FULL_SLOTS); // full slots minus 1
+    else slots = semaphore_p_batch(semid, FULL_SLOTS, batch); // full slots minus slots
+    if (stalled) record_stall(&current_consumer(ring_buffer)->stats, &start);
+    return slots;
+}
+
+// sparse copy, source had a hole from offset to end
+// dest is truncated before copy(or created in directory mode), so there's nothing to write,
+// the hole is only counted so that progress bar accounts for it
+void skip_hole(struct Transfer * transfer, off_t offset, off_t end) {
+    if (end <= offset) return;
+    if (verbose_flag) printf("%s: %lld bytes of hole skipped.\n", __progname, (long long)(end - offset));
+    skip_bytes(transfer->ring_buffer, end - offset);
+}
+
+// get bytes from shared ring buffer, one write at a time
+// each slot is written where put read it, gaps between slots are holes
+void get_synchronously(struct Transfer * transfer, int fd, int tail_fd) {
+    struct RingBuffer * ring_buffer = transfer->ring_buffer;
+    int semid = transfer->semid;
+    off_t offset = transfer->offset, end = transfer->offset + transfer->length;
+    off_t slot_offset; // file offset of peeked buffer entry
+    int byte_count; // byte number that read from ring buffer
+    char * bytes; // bytes of peeked buffer entry
+    int end_of_file_flag = 0; // mark end of file
+    int slots, drained; // slots acquired and drained in current batch
+    struct timespec start; // start of write in stats mode
+    do {
+        slots = 1;
+        if (type == 1) slots = acquire_full_slots(ring_buffer, semid, batch_size);
+        // semaphore_p(semid, MUTEX_LOCK); // mutex lock acquired
+        for (drained = 0 ; drained < slots && !end_of_file_flag ; ++drained) {
+            bytes = peek_read_extent(ring_buffer, &byte_count, &slot_offset);
+            if (verbose_flag) printf("%s: %d bytes read from ring buffer.\n", __progname, byte_count);
+            if (verify_flag) digest_bytes(transfer, bytes, byte_count);
+            // end of file slot, whatever is left of range is a hole
+            skip_hole(transfer, offset, byte_count ? slot_offset : end);
+            offset = slot_offset;
+            // write from shared memory buffer straight to file
+            // unaligned tail can't be written with O_DIRECT, write it through page cache
+            if (stats_flag) start_stats_clock(&start);
+            Pwrite(direct_io_flag && byte_count % slot_alignment() ? tail_fd : fd, bytes, byte_count, slot_offset);
+            if (byte_count == 0) end_of_file_flag = 1;
+            else if (stats_flag) record_latency(&current_consumer(ring_buffer)->stats, &start);
+            offset += byte_count;
+            release_read_slot(ring_buffer);
+        }
+        // semaphore_v(semid, MUTEX_LOCK); // mutex lock released
+        // unnecessary for mutex
+        if (type == 1) semaphore_v_batch(semid, EMPTY_SLOTS, drained); // empty slots add drained
+        // full slots acquired after end of file belong to next file
+        if (type == 1) semaphore_v_batch(semid, FULL_SLOTS, slots - drained);
+    } while (!end_of_file_flag);
+}
+
+// get bytes from shared ring buffer with io_uring
+// keep queue_depth writes in flight directly from peeked slots, writes may complete
+// out of order but slots are only released in order once they have completed
+// a new slot is only waited for when no peeked slot is left unreleased, otherwise
+// get could sleep on an empty ring buffer while put waits for those very slots
+void get_with_uring(struct Transfer * transfer, int fd, int tail_fd) {
+    struct RingBuffer * ring_buffer = transfer->ring_buffer;
+    int semid = transfer->semid;
+    off_t offset = transfer->offset, end = transfer->offset + transfer->length;
+    struct Uring uring;
+    uring_init(&uring, queue_depth);
+
+    char * buffers[queue_depth]; // bytes of each in-flight slot
+    off_t offsets[queue_depth]; // file offset of each in-flight slot
+    int fds[queue_depth]; // descriptor each in-flight slot is written to
+    int sizes[queue_depth], written[queue_depth]; // bytes stored and written of each in-flight slot
+    struct timespec starts[queue_depth]; // start of write of each in-flight slot in stats mode
+    size_t peeked = 0, released = 0; // slots peeked and released so far
+    int end_of_file_flag = 0; // mark end of file slot peeked
+    unsigned long long slot; // slot number of a completion
+    int result, index; // result of a completion and index of its slot
+    while (!end_of_file_flag || released < peeked) {
+        // keep queue full, stop at end of file slot
+        while (!end_of_file_flag && peeked - released < queue_depth && (peeked == released || number_of_full_slots(ring_buffer) > 0)) {
+            if (type == 1) acquire_full_slots(ring_buffer, semid, 1);
+            index = peeked % queue_depth;
+            buffers[index] = peek_read_extent(ring_buffer, &sizes[index], &offsets[index]);
+            if (verbose_flag) printf("%s: %d bytes read from ring buffer.\n", __progname, sizes[index]);
+            if (verify_flag) digest_bytes(transfer, buffers[index], sizes[index]);
+            written[index] = 0;
+            if (sizes[index] == 0) {
+                // nothing to write, end of file slot completes immediately, rest of range is a hole
+                skip_hole(transfer, offset, end);
+                end_of_file_flag = 1;
+            } else {
+                // gap since previous slot is a hole
+                skip_hole(transfer, offset, offsets[index]);
+                offset = offsets[index];
+                // unaligned tail can't be written with O_DIRECT, write it through page cache
+                fds[index] = direct_io_flag && sizes[index] % slot_alignment() ? tail_fd : fd;
+                if (stats_flag) start_stats_clock(&starts[index]);
+                uring_prepare(&uring, IORING_OP_WRITE, fds[index], buffers[index], sizes[index], offset, peeked);
+                offset += sizes[index];
+            }
+            ++peeked;
+        }
+        // submit and wait only if the oldest slot hasn't completed yet
+        index = released % queue_depth;
+        uring_submit(&uring, released < peeked && written[index] < sizes[index] ? 1 : 0);
+        while (uring_complete(&uring, &slot, &result)) {
+            index = slot % queue_depth;
+            if (result <= 0) {
+                printf("write failed: %s.\n", result < 0 ? strerror(-result) : "nothing written");
+                if (verbose_flag) printf("%s: failed to write to file %s.\n", __progname, transfer->file);
+                exit(-1);
+            }
+            // short write, write the rest of slot
+            written[index] += result;
+            if (written[index] < sizes[index]) {
+                uring_prepare(&uring, IORING_OP_WRITE, fds[index], buffers[index] + written[index], sizes[index] - written[index], offsets[index] + written[index], slot);
+            } else if (stats_flag) {
+                record_latency(&current_consumer(ring_buffer)->stats, &starts[index]);
+            }
+        }
+        // release completed slots in order
+        int drained = 0;
+        while (released < peeked && written[released % queue_depth] == sizes[released % queue_depth]) {
+            release_read_slot(ring_buffer);
+            ++released;
+            ++drained;
+        }
+        if (type == 1) semaphore_v_batch(semid, EMPTY_SLOTS, drained); // empty slots add drained
+    }
+
+    uring_exit(&uring);
+}
+
+// get extents from shared ring buffer and write each one straight from a mapping of source,
+// so bytes are copied once, from page cache of source to page cache of dest, and never by put
+// mapping starts at the page holding start of range, extents are at page aligned offsets from it
+// in direct io mode, so writes from it can still use O_DIRECT
+void get_extents(struct Transfer * transfer, int fd, int tail_fd) {
+    struct RingBuffer * ring_buffer = transfer->ring_buffer;
+    int semid = transfer->semid;
+    off_t offset = transfer->offset, end = transfer->offset + transfer->length;
+    off_t base = transfer->offset / sysconf(_SC_PAGESIZE) * sysconf(_SC_PAGESIZE);
+    size_t span = end - base;
+    char * mapping = NULL;
+    if (span) {
+        int source_fd = Open(transfer->source, O_RDONLY);
+        if ((mapping = mmap(NULL, span, PROT_READ, MAP_SHARED, source_fd, base)) == MAP_FAILED) {
+            printf("mmap failed: %s.\n", strerror(errno));
+            if (verbose_flag) printf("%s: failed to map source file %s.\n", __progname, transfer->source);
+            exit(-1);
+        }
+        madvise(mapping, span, MADV_SEQUENTIAL);
+        close(source_fd);
+    }
+    off_t slot_offset; // file offset of peeked extent
+    int size; // bytes of peeked extent
+    int end_of_file_flag = 0; // mark end of file
+    int slots, drained; // slots acquired and drained in current batch
+    struct timespec start; // start of write in stats mode
+    do {
+        slots = 1;
+        if (type == 1) slots = acquire_full_slots(ring_buffer, semid, batch_size);
+        for (drained = 0 ; drained < slots && !end_of_file_flag ; ++drained) {
+            peek_read_extent(ring_buffer, &size, &slot_offset);
+            if (verbose_flag) printf("%s: extent of %d bytes at %lld got.\n", __progname, size, (long long)slot_offset);
+            // end of file slot, whatever is left of range is a hole
+            skip_hole(transfer, offset, size ? slot_offset : end);
+            if (size == 0) {
+                end_of_file_flag = 1;
+            } else {
+                // unaligned tail can't be written with O_DIRECT, write it through page cache
+                if (stats_flag) start_stats_clock(&start);
+                Pwrite(direct_io_flag && size % slot_alignment() ? tail_fd : fd, mapping + (slot_offset - base), size, slot_offset);
+                if (stats_flag) record_latency(&current_consumer(ring_buffer)->stats, &start);
+                offset = slot_offset + size;
+            }
+            release_read_slot(ring_buffer);
+        }
+        if (type == 1) semaphore_v_batch(semid, EMPTY_SLOTS, drained); // empty slots add drained
+        // full slots acquired after end of file belong to next file
+        if (type == 1) semaphore_v_batch(semid, FULL_SLOTS, slots - drained);
+    } while (!end_of_file_flag);
+    if (mapping) munmap(mapping, span);
+}
+
+// readv wrapper, retries when interrupted
+ssize_t Readv(int fildes, const struct iovec * iov, int iovcnt) {
+    ssize_t result = -1;
+    while ((result = readv(fildes, iov, iovcnt)) == -1 && errno == EINTR);
+    if (result == -1) {
+        printf("read failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to read from source file.\n", __progname);
+        exit(-1);
+    }
+    return result;
+}
+
+// writev wrapper, writes all pieces even if pipe or socket only takes part of them at a time
+// returns the number of bytes written
+size_t Writev(int fildes, struct iovec * iov, int iovcnt) {
+    size_t total = 0;
+    while (iovcnt > 0) {
+        ssize_t result = writev(fildes, iov, iovcnt);
+        if (result == -1) {
+            if (errno == EINTR) continue;
+            printf("write failed: %s.\n", strerror(errno));
+            if (verbose_flag) printf("%s: failed to write to dest file.\n", __progname);
+            exit(-1);
+        }
+        total += result;
+        // skip pieces written completely, then the written part of the next one
+        while (iovcnt > 0 && (size_t)result >= iov->iov_len) {
+            result -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + result;
+            iov->iov_len -= result;
+        }
+    }
+    return total;
+}
+
+// open wrapper, dest file is only created here in stream mode
+int Open(const char * file, int flags) {
+    int fd = -1;
+    if ((fd = open(file, flags, S_IRUSR | S_IWUSR)) == -1) {
+        printf("open failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to open file %s.\n", __progname, file);
+        exit(-1);
+    }
+    if (verbose_flag) printf("%s: file %s opened.\n", __progname, file);
+    return fd;
+}
+
+// put bytes to stream ring, one read per record, reads from pipes and sockets are usually short
+// range is ignored, the whole source is read until end of file
+void put_stream(struct Transfer * transfer, int fd) {
+    struct RingBuffer * ring_buffer = transfer->ring_buffer;
+    int semid = transfer->semid;
+    struct iovec pieces[2]; // room of record, two pieces if it wraps around
+    ssize_t byte_count; // byte number that read from file
+    int end_of_file_flag = 0; // mark end of file
+    struct timespec start; // start of read in stats mode
+    do {
+        // semaphore implementation counts records, each one has room for buffer capacity bytes
+        if (type == 1) acquire_empty_slots(ring_buffer, semid, 1);
+        int count = reserve_stream_record(ring_buffer, pieces);
+        if (stats_flag) start_stats_clock(&start);
+        if ((byte_count = Readv(fd, pieces, count)) == 0) end_of_file_flag = 1;
+        if (stats_flag) record_latency(&ring_buffer->producer_stats, &start);
+        if (verbose_flag) printf("%s: %zd bytes read from file.\n", __progname, byte_count);
+        if (verify_flag) digest_pieces(transfer, pieces, count, byte_count);
+        commit_stream_record(ring_buffer, byte_count);
+        if (type == 1) semaphore_v(semid, FULL_SLOTS); // full slots add 1
+    } while (!end_of_file_flag);
+}
+
+// get bytes from stream ring, all records available are drained by one write
+void get_stream(struct Transfer * transfer, int fd) {
+    struct RingBuffer * ring_buffer = transfer->ring_buffer;
+    int semid = transfer->semid;
+    struct iovec pieces[2 * STREAM_MAX_RECORDS]; // bytes of peeked records
+    int records = 0, count = 0; // records peeked and their pieces
+    int end_of_file_flag = 0; // mark end of file
+    struct timespec start; // start of write in stats mode
+    do {
+        int slots = STREAM_MAX_RECORDS;
+        if (type == 1) slots = acquire_full_slots(ring_buffer, semid, STREAM_MAX_RECORDS);
+        count = peek_stream_records(ring_buffer, pieces, slots, &records, &end_of_file_flag);
+        // digest before write, Writev moves pieces along as they are written
+        if (verify_flag) digest_pieces(transfer, pieces, count, SIZE_MAX);
+        if (stats_flag) start_stats_clock(&start);
+        size_t byte_count = count ? Writev(fd, pieces, count) : 0;
+        if (stats_flag && count) record_latency(&current_consumer(ring_buffer)->stats, &start);
+        if (verbose_flag) printf("%s: %zu bytes of %d records written to file.\n", __progname, byte_count, records);
+        release_stream_records(ring_buffer, byte_count);
+        if (type == 1) semaphore_v_batch(semid, EMPTY_SLOTS, records); // empty slots add records
+    } while (!end_of_file_flag);
+}
+
+// claim slots from ring buffer, transform them into their transformed slots and release them in order
+void * transform_worker(void * argument) {
+    struct Pipeline * pipeline = argument;
+    struct RingBuffer * ring_buffer = pipeline->transfer->ring_buffer;
+    int semid = pipeline->transfer->semid;
+    size_t room = transform_bound(pipeline->transform, buffer_capacity);
+    struct Transformer transformer;
+    init_transformer(&transformer, pipeline->transform);
+    for (;;) {
+        // claim next slot, only one worker at a time plays consumer of ring buffer
+        pthread_mutex_lock(&pipeline->input_mutex);
+        while (!pipeline->end_of_file && pipeline->claimed > pipeline->released && number_of_full_slots(ring_buffer) == 0) {
+            pthread_cond_wait(&pipeline->input_transformed, &pipeline->input_mutex);
+        }
+        if (pipeline->end_of_file) {
+            pthread_mutex_unlock(&pipeline->input_mutex);
+            break;
+        }
+        if (type == 1) acquire_full_slots(ring_buffer, semid, 1);
+        int size;
+        char * bytes = peek_read_slot(ring_buffer, &size);
+        size_t sequence = pipeline->claimed++;
+        if (size == 0) pipeline->end_of_file = 1;
+        pthread_mutex_unlock(&pipeline->input_mutex);
+
+        // wait until writer is done with what sequence - buffer number left in transformed slot
+        struct TransformedSlot * slot = &pipeline->slots[sequence % buffer_number];
+        pthread_mutex_lock(&pipeline->output_mutex);
+        while (slot->ready) pthread_cond_wait(&pipeline->output_free, &pipeline->output_mutex);
+        pthread_mutex_unlock(&pipeline->output_mutex);
+
+        // transform outside of any lock, this is what runs in parallel
+        slot->size = size ? transform_bytes(&transformer, bytes, size, slot->bytes, room) : 0;
+        if (verbose_flag) printf("%s: slot %zu transformed from %d to %zu bytes.\n", __progname, sequence, size, slot->size);
+        pthread_mutex_lock(&pipeline->output_mutex);
+        slot->sequence = sequence;
+        slot->end_of_file = size == 0;
+        slot->ready = 1;
+        pthread_cond_broadcast(&pipeline->output_ready);
+        pthread_mutex_unlock(&pipeline->output_mutex);
+
+        // release transformed slots of ring buffer, oldest first
+        pthread_mutex_lock(&pipeline->input_mutex);
+        pipeline->done[sequence % buffer_number] = 1;
+        int drained = 0;
+        while (pipeline->released < pipeline->claimed && pipeline->done[pipeline->released % buffer_number]) {
+            pipeline->done[pipeline->released % buffer_number] = 0;
+            release_read_slot(ring_buffer);
+            ++pipeline->released;
+            ++drained;
+        }
+        if (type == 1) semaphore_v_batch(semid, EMPTY_SLOTS, drained); // empty slots add drained
+        pthread_cond_broadcast(&pipeline->input_transformed);
+        pthread_mutex_unlock(&pipeline->input_mutex);
+    }
+    end_transformer(&transformer);
+    return NULL;
+}
+
+void transform_range(struct Transfer * transfer, int transform, int workers) {
+    // output size is unknown, dest file is written from the start like in stream mode
+    int fd = Open(transfer->file, O_WRONLY | O_CREAT | O_TRUNC);
+
+    struct Pipeline pipeline;
+    memset(&pipeline, 0, sizeof(struct Pipeline));
+    pipeline.transfer = transfer;
+    pipeline.transform = transform;
+    pthread_mutex_init(&pipeline.input_mutex, NULL);
+    pthread_mutex_init(&pipeline.output_mutex, NULL);
+    pthread_cond_init(&pipeline.input_transformed, NULL);
+    pthread_cond_init(&pipeline.output_ready, NULL);
+    pthread_cond_init(&pipeline.output_free, NULL);
+    pipeline.done = calloc(buffer_number, sizeof(int));
+    pipeline.slots = calloc(buffer_number, sizeof(struct TransformedSlot));
+    size_t room = transform_bound(transform, buffer_capacity);
+    for (int index = 0 ; index < buffer_number ; ++index) pipeline.slots[index].bytes = malloc(room);
+
+    pthread_t threads[workers];
+    for (int worker = 0 ; worker < workers ; ++worker) {
+        if (pthread_create(&threads[worker], NULL, transform_worker, &pipeline) != 0) {
+            printf("pthread_create failed.\n");
+            if (verbose_flag) printf("%s: failed to create transform workers.\n", __progname);
+            exit(-1);
+        }
+    }
+
+    // write transformed slots in sequence until the empty one
+    struct timespec start; // start of write in stats mode
+    for (size_t sequence = 0 ; ; ++sequence) {
+        struct TransformedSlot * slot = &pipeline.slots[sequence % buffer_number];
+        pthread_mutex_lock(&pipeline.output_mutex);
+        while (!slot->ready || slot->sequence != sequence) pthread_cond_wait(&pipeline.output_ready, &pipeline.output_mutex);
+        pthread_mutex_unlock(&pipeline.output_mutex);
+        if (slot->end_of_file) break;
+
+        struct iovec piece = {slot->bytes, slot->size};
+        if (stats_flag) start_stats_clock(&start);
+        transfer->size += Writev(fd, &piece, 1);
+        if (stats_flag) record_latency(&current_consumer(transfer->ring_buffer)->stats, &start);
+
+        pthread_mutex_lock(&pipeline.output_mutex);
+        slot->ready = 0;
+        pthread_cond_broadcast(&pipeline.output_free);
+        pthread_mutex_unlock(&pipeline.output_mutex);
+    }
+
+    for (int worker = 0 ; worker < workers ; ++worker) pthread_join(threads[worker], NULL);
+    for (int index = 0 ; index < buffer_number ; ++index) free(pipeline.slots[index].bytes);
+    free(pipeline.slots);
+    free(pipeline.done);
+    pthread_cond_destroy(&pipeline.input_transformed);
+    pthread_cond_destroy(&pipeline.output_ready);
+    pthread_cond_destroy(&pipeline.output_free);
+    pthread_mutex_destroy(&pipeline.input_mutex);
+    pthread_mutex_destroy(&pipeline.output_mutex);
+    close(fd);
+}
+
+void put_range(struct Transfer * transfer) {
+    int fd = Open(transfer->file, O_RDONLY | (direct_io_flag ? O_DIRECT : 0));
+
+    // put bytes to ring buffer
+    if (stream_flag) put_stream(transfer, fd);
+    else if (mmap_flag) put_extents(transfer, fd);
+    else if (engine == ENGINE_URING) put_with_uring(transfer, fd);
+    else put_synchronously(transfer, fd);
+
+    // publish digest of source, simple-cp compares it with dest's once both sides have exited
+    if (verify_flag) {
+        transfer->ring_buffer->source_size = transfer->size;
+        transfer->ring_buffer->source_digest = transfer->digest;
+    }
+
+    close(fd);
+}
+
+void get_range(struct Transfer * transfer) {
+    // dest file is created and preallocated by simple-cp, except in stream mode where it may be a pipe
+    // and in directory mode where there are too many of them
+    int fd = Open(transfer->file, O_WRONLY | (direct_io_flag ? O_DIRECT : 0) | (stream_flag || transfer->create ? O_CREAT | O_TRUNC : 0));
+    // open dest file again through page cache for the unaligned tail
+    int tail_fd = direct_io_flag ? Open(transfer->file, O_WRONLY) : -1;
+
+    // get bytes from ring buffer
+    if (stream_flag) get_stream(transfer, fd);
+    else if (mmap_flag) get_extents(transfer, fd, tail_fd);
+    else if (engine == ENGINE_URING) get_with_uring(transfer, fd, tail_fd);
+    else get_synchronously(transfer, fd, tail_fd);
+
+    if (verify_flag) current_consumer(transfer->ring_buffer)->dest_digest = transfer->digest;
+
+    // created dest file gets its full size even if source ends with a hole
+    if (transfer->create && ftruncate(fd, transfer->offset + transfer->length) == -1) {
+        printf("ftruncate failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to set size of file %s.\n", __progname, transfer->file);
+        exit(-1);
+    }
+
+    close(fd);
+    if (tail_fd != -1) close(tail_fd);
+}
@@ -0,0 +1,34 @@
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "ring-buffer.h"
+
+// one side of a copy, a range of file moved through a ring buffer
+// shared by put/get processes and the threads of --threads mode
+struct Transfer {
+    struct RingBuffer * ring_buffer; // ring buffer to put to or get from
+    int semid; // semaphore set(semaphore implementation only)
+    const char * file; // source file for put, dest file for get
+    off_t offset, length; // range of file
+    uint32_t digest; // crc32c of bytes put/got so far(verify mode only)
+    size_t size; // bytes put/got so far(verify mode only)
+    int create; // dest file isn't preallocated, get creates or truncates it
+    const char * source; // source file get maps and writes from(mmap mode only)
+};
+
+// read range of source file into ring buffer, followed by an empty slot as end of file
+// mmap mode, only extents of range are put, nothing is read
+// verify mode, crc32c of what was read is left in ring buffer's source_digest
+void put_range(struct Transfer * transfer);
+// write slots from ring buffer to range of dest file until the empty slot
+// mmap mode, slots only describe extents and their bytes are written from a mapping of source
+// verify mode, crc32c of what was written is left in dest_digest of its consumer of ring buffer
+void get_range(struct Transfer * transfer);
+// pipeline mode, workers threads transform slots from ring buffer in parallel and calling thread
+// writes them to dest file in slot order, size is set to bytes written(threads only)
+void transform_range(struct Transfer * transfer, int transform, int workers);
+
+#endif
@@ -0,0 +1,67 @@
+// include system headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+// include own header
+#include "transform.h"
+
+extern const char * __progname; // gcc defined as substitute for argv[0]
+
+extern int verbose_flag; // verbose flag
+
+#define GZIP_WINDOW_BITS (15 + 16) // max window, plus 16 for gzip header and trailer instead of zlib's
+#define GZIP_WRAPPER_SIZE 18 // gzip header and trailer, compressBound only counts zlib's 6 bytes
+
+const char * transform_name(int transform) {
+    if (transform == TRANSFORM_GZIP) return "gzip";
+    if (transform == TRANSFORM_UPPER) return "upper";
+    return "none";
+}
+
+size_t transform_bound(int transform, size_t size) {
+    if (transform == TRANSFORM_GZIP) return compressBound(size) + GZIP_WRAPPER_SIZE;
+    return size;
+}
+
+void init_transformer(struct Transformer * transformer, int transform) {
+    memset(transformer, 0, sizeof(struct Transformer));
+    transformer->transform = transform;
+    if (transform != TRANSFORM_GZIP) return;
+    int result = deflateInit2(&transformer->stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY);
+    if (result != Z_OK) {
+        printf("deflateInit2 failed: %s.\n", zError(result));
+        if (verbose_flag) printf("%s: failed to initialize compressor.\n", __progname);
+        exit(-1);
+    }
+}
+
+size_t transform_bytes(struct Transformer * transformer, const char * input, size_t size, char * output, size_t room) {
+    if (transformer->transform == TRANSFORM_GZIP) {
+        // one whole gzip member per slot, reset keeps allocated window and hash tables
+        z_stream * stream = &transformer->stream;
+        deflateReset(stream);
+        stream->next_in = (Bytef *)input;
+        stream->avail_in = size;
+        stream->next_out = (Bytef *)output;
+        stream->avail_out = room;
+        int result = deflate(stream, Z_FINISH);
+        if (result != Z_STREAM_END) {
+            printf("deflate failed: %s.\n", stream->msg ? stream->msg : zError(result));
+            if (verbose_flag) printf("%s: failed to compress %zu bytes.\n", __progname, size);
+            exit(-1);
+        }
+        return stream->total_out;
+    }
+    if (transformer->transform == TRANSFORM_UPPER) {
+        for (size_t index = 0 ; index < size ; ++index) output[index] = toupper((unsigned char)input[index]);
+        return size;
+    }
+    memcpy(output, input, size);
+    return size;
+}
+
+void end_transformer(struct Transformer * transformer) {
+    if (transformer->transform == TRANSFORM_GZIP) deflateEnd(&transformer->stream);
+}
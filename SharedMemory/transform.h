@@ -0,0 +1,32 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <stddef.h>
+#include <zlib.h>
+
+// transforms applied to each slot in pipeline mode
+#define TRANSFORM_NONE 0
+#define TRANSFORM_GZIP 1 // each slot becomes a gzip member, concatenated members are still one gzip file
+#define TRANSFORM_UPPER 2 // byte filter, ascii letters to upper case
+
+// every gzip member costs a header, a trailer and a fresh dictionary, small slots make output
+// grow instead of shrink, so slots are at least this large with gzip
+#define GZIP_MIN_CAPACITY (1 << 20)
+
+// per worker state, compressor is kept between slots instead of being set up for each one
+struct Transformer {
+    int transform;
+    z_stream stream;
+};
+
+// name of transform for messages
+const char * transform_name(int transform);
+// max bytes a transform turns size bytes into
+size_t transform_bound(int transform, size_t size);
+
+void init_transformer(struct Transformer * transformer, int transform);
+// transform size bytes of input into output, returns transformed size
+size_t transform_bytes(struct Transformer * transformer, const char * input, size_t size, char * output, size_t room);
+void end_transformer(struct Transformer * transformer);
+
+#endif
@@ -0,0 +1,59 @@
+// include system headers
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+// include own header
+#include "tuning.h"
+
+#define MAX_SYSFS_PATH_LENGTH 96 // longest sysfs queue attribute path
+
+// private function list
+long read_queue_attribute(dev_t device, const char * attribute);
+
+// read an attribute of request queue of block device holding a file, -1 if unknown
+// a partition has no queue of its own, queue of its disk is tried next
+long read_queue_attribute(dev_t device, const char * attribute) {
+    const char * formats[] = {"/sys/dev/block/%u:%u/queue/%s", "/sys/dev/block/%u:%u/../queue/%s"};
+    for (int i = 0 ; i < 2 ; ++i) {
+        char path[MAX_SYSFS_PATH_LENGTH];
+        snprintf(path, sizeof(path), formats[i], major(device), minor(device), attribute);
+        FILE * file = fopen(path, "r");
+        if (!file) continue;
+        long value = -1;
+        if (fscanf(file, "%ld", &value) != 1) value = -1;
+        fclose(file);
+        return value;
+    }
+    return -1;
+}
+
+int initial_capacity(const char * source, const char * dest, int minimum) {
+    long capacity = minimum;
+    struct stat file_stat;
+    if (stat(source, &file_stat) == 0) {
+        if (file_stat.st_blksize > capacity) capacity = file_stat.st_blksize;
+        long optimal = read_queue_attribute(file_stat.st_dev, "optimal_io_size");
+        if (optimal > capacity) capacity = optimal;
+        if (read_queue_attribute(file_stat.st_dev, "rotational") == 1 && capacity < AUTO_ROTATIONAL_CAPACITY) capacity = AUTO_ROTATIONAL_CAPACITY;
+    }
+    // dest doesn't exist before its first copy
+    if (stat(dest, &file_stat) == 0 && file_stat.st_blksize > capacity) capacity = file_stat.st_blksize;
+
+    int power = minimum;
+    while (power < capacity && power < AUTO_MAX_CAPACITY) power *= 2;
+    return power;
+}
+
+int auto_candidates(int capacity, int * capacities) {
+    int count = 0;
+    capacities[count++] = capacity;
+    while (count < AUTO_CANDIDATES && capacity * 4 <= AUTO_MAX_CAPACITY) capacities[count++] = capacity *= 4;
+    return count;
+}
+
+int auto_number(int capacity, int minimum) {
+    int number = AUTO_RING_SIZE / capacity;
+    return number > minimum ? number : minimum;
+}
@@ -0,0 +1,20 @@
+#ifndef TUNING_H
+#define TUNING_H
+
+#define AUTO_MIN_CAPACITY 4096 // smallest slot auto mode starts from
+#define AUTO_MAX_CAPACITY (1 << 20) // largest slot auto mode tries
+#define AUTO_ROTATIONAL_CAPACITY (1 << 16) // smallest slot on a spinning disk, seeks dominate smaller reads
+#define AUTO_CANDIDATES 4 // slot sizes tried, each one 4 times the previous one
+#define AUTO_RING_SIZE (8 << 20) // bytes of slots of every candidate ring, slot count follows slot size
+#define AUTO_PROBE_SIZE (4 << 20) // bytes of source copied with each candidate
+#define AUTO_PROBE_RATIO 4 // source must be this many times larger than all probes together to be probed
+
+// first guess of slot size, the largest of source/dest block size and source device's optimal io size,
+// rounded up to a power of two between minimum and AUTO_MAX_CAPACITY
+int initial_capacity(const char * source, const char * dest, int minimum);
+// slot sizes worth trying starting from first guess, returns how many are stored in capacities
+int auto_candidates(int capacity, int * capacities);
+// slot count of a candidate ring, never fewer than minimum
+int auto_number(int capacity, int minimum);
+
+#endif
@@ -0,0 +1,115 @@
+// include system headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// include own header
+#include "uring.h"
+
+extern const char * __progname; // gcc defined as substitute for argv[0]
+
+extern int verbose_flag; // verbose flag
+
+// private function list, all wrapper functions
+void * Uring_mmap(int fd, size_t length, off_t offset);
+
+// mmap wrapper for io_uring regions
+void * Uring_mmap(int fd, size_t length, off_t offset) {
+    void * ptr = MAP_FAILED;
+    if ((ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset)) == MAP_FAILED) {
+        printf("mmap failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to map io_uring queues.\n", __progname);
+        exit(-1);
+    }
+    return ptr;
+}
+
+void uring_init(struct Uring * uring, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(uring, 0, sizeof(*uring));
+    if ((uring->fd = syscall(SYS_io_uring_setup, entries, &params)) == -1) {
+        printf("io_uring_setup failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to setup io_uring with %u entries.\n", __progname, entries);
+        exit(-1);
+    }
+    uring->entries = params.sq_entries;
+
+    // map submission queue ring, completion queue ring and sqes
+    uring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    uring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    // both rings share one mapping on newer kernels
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (uring->cq_ring_size > uring->sq_ring_size) uring->sq_ring_size = uring->cq_ring_size;
+        uring->cq_ring_size = uring->sq_ring_size;
+    }
+    uring->sq_ring = Uring_mmap(uring->fd, uring->sq_ring_size, IORING_OFF_SQ_RING);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) uring->cq_ring = uring->sq_ring;
+    else uring->cq_ring = Uring_mmap(uring->fd, uring->cq_ring_size, IORING_OFF_CQ_RING);
+    uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    uring->sqes = Uring_mmap(uring->fd, uring->sqes_size, IORING_OFF_SQES);
+
+    uring->sq_head = (unsigned *)((char *)uring->sq_ring + params.sq_off.head);
+    uring->sq_tail = (unsigned *)((char *)uring->sq_ring + params.sq_off.tail);
+    uring->sq_mask = (unsigned *)((char *)uring->sq_ring + params.sq_off.ring_mask);
+    uring->sq_array = (unsigned *)((char *)uring->sq_ring + params.sq_off.array);
+    uring->cq_head = (unsigned *)((char *)uring->cq_ring + params.cq_off.head);
+    uring->cq_tail = (unsigned *)((char *)uring->cq_ring + params.cq_off.tail);
+    uring->cq_mask = (unsigned *)((char *)uring->cq_ring + params.cq_off.ring_mask);
+    uring->cqes = (struct io_uring_cqe *)((char *)uring->cq_ring + params.cq_off.cqes);
+    if (verbose_flag) printf("%s: io_uring with %u entries set up.\n", __progname, uring->entries);
+}
+
+void uring_exit(struct Uring * uring) {
+    munmap(uring->sqes, uring->sqes_size);
+    if (uring->cq_ring != uring->sq_ring) munmap(uring->cq_ring, uring->cq_ring_size);
+    munmap(uring->sq_ring, uring->sq_ring_size);
+    close(uring->fd);
+}
+
+void uring_prepare(struct Uring * uring, int opcode, int fd, void * buffer, unsigned len, off_t offset, unsigned long long user_data) {
+    // only this process touches sq tail, kernel moves sq head
+    unsigned tail = *uring->sq_tail;
+    unsigned index = tail & *uring->sq_mask;
+    struct io_uring_sqe * sqe = &uring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long)buffer;
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    uring->sq_array[index] = index;
+    // release makes sqe visible to kernel before new tail
+    __atomic_store_n(uring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++uring->to_submit;
+}
+
+void uring_submit(struct Uring * uring, unsigned wait_number) {
+    if (uring->to_submit == 0 && wait_number == 0) return;
+    int result;
+    while ((result = syscall(SYS_io_uring_enter, uring->fd, uring->to_submit, wait_number, wait_number ? IORING_ENTER_GETEVENTS : 0, NULL, 0)) == -1) {
+        if (errno == EINTR) continue;
+        printf("io_uring_enter failed: %s.\n", strerror(errno));
+        if (verbose_flag) printf("%s: failed to submit io_uring requests.\n", __progname);
+        exit(-1);
+    }
+    uring->to_submit -= result;
+}
+
+int uring_complete(struct Uring * uring, unsigned long long * user_data, int * result) {
+    // only this process touches cq head, kernel moves cq tail
+    unsigned head = *uring->cq_head;
+    if (head == __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE)) return 0;
+    struct io_uring_cqe * cqe = &uring->cqes[head & *uring->cq_mask];
+    *user_data = cqe->user_data;
+    *result = cqe->res;
+    // release gives cqe back to kernel after it has been read
+    __atomic_store_n(uring->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
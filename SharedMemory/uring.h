@@ -0,0 +1,35 @@
+#ifndef URING_H
+#define URING_H
+
+#include <sys/types.h>
+#include <linux/io_uring.h>
+
+// minimal io_uring wrapper on raw system calls, no liburing needed
+// submission queue and completion queue are shared with kernel through mmap
+struct Uring {
+    int fd;
+    unsigned entries; // submission queue entries
+    // submission queue
+    unsigned * sq_head, * sq_tail, * sq_mask, * sq_array;
+    struct io_uring_sqe * sqes;
+    unsigned to_submit; // sqes prepared but not submitted yet
+    // completion queue
+    unsigned * cq_head, * cq_tail, * cq_mask;
+    struct io_uring_cqe * cqes;
+    // mapped regions
+    void * sq_ring, * cq_ring;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+};
+
+// setup and teardown
+void uring_init(struct Uring * uring, unsigned entries);
+void uring_exit(struct Uring * uring);
+
+// prepare a read/write of len bytes at offset, user_data comes back with its completion
+void uring_prepare(struct Uring * uring, int opcode, int fd, void * buffer, unsigned len, off_t offset, unsigned long long user_data);
+// submit prepared sqes and wait for at least wait_number completions
+void uring_submit(struct Uring * uring, unsigned wait_number);
+// fetch one completion without system call, return 0 if there is none
+int uring_complete(struct Uring * uring, unsigned long long * user_data, int * result);
+
+#endif